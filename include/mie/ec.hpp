@@ -7,9 +7,11 @@
 	http://opensource.org/licenses/BSD-3-Clause
 */
 #include <sstream>
+#include <string.h>
 #include <cybozu/exception.hpp>
 #include <mie/operator.hpp>
 #include <mie/power.hpp>
+#include <mie/tagfield.hpp>
 
 namespace mie {
 
@@ -38,6 +40,7 @@ class EcT : public ope::addsub<EcT<_Fp>,
 	};
 public:
 	typedef _Fp Fp;
+	typedef TagField<Fp> Field; // small multiples of Fp
 #if MIE_EC_COORD == MIE_EC_USE_AFFINE
 	Fp x, y;
 	bool inf_;
@@ -47,11 +50,10 @@ public:
 	static Fp a_;
 	static Fp b_;
 	static int specialA_;
-#if MIE_EC_COORD == MIE_EC_USE_AFFINE
-	EcT() : inf_(true) {}
-#else
-	EcT() { z.clear(); }
-#endif
+	/*
+		zero with x and y cleared, so that copying it never reads uninitialized limbs
+	*/
+	EcT() { clear(); }
 	EcT(const Fp& _x, const Fp& _y)
 	{
 		set(_x, _y);
@@ -75,6 +77,54 @@ public:
 		z = 1;
 #endif
 	}
+	/*
+		normalize P[0, n) with one inversion (Montgomery's trick)
+		zero and already normalized points are skipped
+		c : scratch of n elements
+	*/
+	static inline void normalizeVec(EcT *P, size_t n, Fp *c)
+	{
+#if MIE_EC_COORD == MIE_EC_USE_AFFINE
+		cybozu::disable_warning_unused_variable(P);
+		cybozu::disable_warning_unused_variable(n);
+		cybozu::disable_warning_unused_variable(c);
+#else
+		// c[i] = product of z of P[0, i] to be normalized
+		Fp prod = 1;
+		bool done = true;
+		for (size_t i = 0; i < n; i++) {
+			if (!P[i].isZero() && P[i].z != 1) {
+				prod *= P[i].z;
+				done = false;
+			}
+			c[i] = prod;
+		}
+		if (done) return;
+		Fp r, rz;
+		Fp::inv(r, prod);
+		for (size_t i = n; i > 0; i--) {
+			EcT& Q = P[i - 1];
+			if (Q.isZero() || Q.z == 1) continue;
+			if (i > 1) {
+				Fp::mul(rz, r, c[i - 2]);
+				r *= Q.z;
+			} else {
+				rz = r;
+			}
+#if MIE_EC_COORD == MIE_EC_USE_JACOBI
+			Fp rz2;
+			Fp::square(rz2, rz);
+			Q.x *= rz2;
+			rz2 *= rz;
+			Q.y *= rz2;
+#else
+			Q.x *= rz;
+			Q.y *= rz;
+#endif
+			Q.z = 1;
+		}
+#endif
+	}
 
 	static inline void setParam(const std::string& astr, const std::string& bstr)
 	{
@@ -124,20 +174,17 @@ public:
 		Fp S, M, t, y2;
 		Fp::square(y2, P.y);
 		Fp::mul(S, P.x, y2);
-		S += S;
-		S += S;
+		Field::mulBy4(S, S);
 		Fp::square(M, P.x);
 		switch (specialA_) {
 		case zero:
-			Fp::add(t, M, M);
-			M += t;
+			Field::mulBy3(M, M);
 			break;
 		case minus3:
 			Fp::square(t, P.z);
 			Fp::square(t, t);
 			M -= t;
-			Fp::add(t, M, M);
-			M += t;
+			Field::mulBy3(M, M);
 			break;
 		case generic:
 		default:
@@ -150,14 +197,11 @@ public:
 			break;
 		}
 		Fp::square(R.x, M);
-		R.x -= S;
-		R.x -= S;
+		Field::sub2(R.x, R.x, S);
 		Fp::mul(R.z, P.y, P.z);
 		R.z += R.z;
 		Fp::square(y2, y2);
-		y2 += y2;
-		y2 += y2;
-		y2 += y2;
+		Field::mulBy8(y2, y2);
 		Fp::sub(R.y, S, R.x);
 		R.y *= M;
 		R.y -= y2;
@@ -166,34 +210,29 @@ public:
 		switch (specialA_) {
 		case zero:
 			Fp::square(w, P.x);
-			Fp::add(t, w, w);
-			w += t;
+			Field::mulBy3(w, w);
 			break;
 		case minus3:
 			Fp::square(w, P.x);
 			Fp::square(t, P.z);
 			w -= t;
-			Fp::add(t, w, w);
-			w += t;
+			Field::mulBy3(w, w);
 			break;
 		case generic:
 		default:
 			Fp::square(w, P.z);
 			w *= a_;
 			Fp::square(t, P.x);
-			w += t;
-			w += t;
+			Field::mulBy3(t, t);
 			w += t; // w = a z^2 + 3x^2
 			break;
 		}
 		Fp::mul(R.z, P.y, P.z); // s = yz
 		Fp::mul(t, R.z, P.x);
 		t *= P.y; // xys
-		t += t;
-		t += t; // 4(xys) ; 4B
+		Field::mulBy4(t, t); // 4(xys) ; 4B
 		Fp::square(h, w);
-		h -= t;
-		h -= t; // w^2 - 8B
+		Field::sub2(h, h, t); // w^2 - 8B
 		Fp::mul(R.x, h, R.z);
 		t -= h; // h is free
 		t *= w;
@@ -203,13 +242,11 @@ public:
 		Fp::square(h, R.z);
 		w *= h;
 		R.z *= h;
-		Fp::sub(R.y, t, w);
-		R.y -= w;
+		Field::sub2(R.y, t, w);
 #else
 		Fp t, s;
 		Fp::square(t, P.x);
-		Fp::add(s, t, t);
-		t += s;
+		Field::mulBy3(t, t);
 		t += a_;
 		Fp::add(s, P.y, P.y);
 		t /= s;
@@ -254,8 +291,7 @@ public:
 		Fp::square(R.y, r); // r^2
 		U1 *= H3; // U1 H^2
 		H3 *= H; // H^3
-		R.y -= U1;
-		R.y -= U1;
+		Field::sub2(R.y, R.y, U1);
 		Fp::sub(R.x, R.y, H3);
 		U1 -= R.x;
 		U1 *= r;
@@ -287,8 +323,7 @@ public:
 		R.z *= vv;
 		A -= vv;
 		vv *= PyQz;
-		A -= r;
-		A -= r;
+		Field::sub2(A, A, r);
 		Fp::mul(R.x, v, A);
 		r -= A;
 		R.y *= r;
@@ -314,6 +349,75 @@ public:
 		s *= t;
 		Fp::sub(R.y, s, P.y);
 		R.x = x3;
+#endif
+	}
+	/*
+		R = P + Q where Q is zero or normalized (Q.z = 1)
+	*/
+	static inline void addMixed(EcT& R, const EcT& P, const EcT& Q)
+	{
+		if (P.isZero()) { R = Q; return; }
+		if (Q.isZero()) { R = P; return; }
+#if MIE_EC_COORD == MIE_EC_USE_JACOBI
+		assert(Q.z == 1);
+		Fp r, U1, H, H3, X3;
+		Fp::square(r, P.z);
+		Fp::mul(H, Q.x, r); // X2 Z1^2
+		r *= P.z; // Z1^3
+		H -= P.x;
+		r *= Q.y;
+		r -= P.y;
+		if (H.isZero()) {
+			if (r.isZero()) {
+				dbl(R, P, false);
+			} else {
+				R.clear();
+			}
+			return;
+		}
+		Fp::square(H3, H); // H^2
+		Fp::mul(U1, P.x, H3); // X1 H^2
+		Fp::mul(R.z, P.z, H);
+		H3 *= H; // H^3
+		Fp::square(X3, r);
+		Field::sub2(X3, X3, U1);
+		X3 -= H3;
+		U1 -= X3;
+		U1 *= r;
+		H3 *= P.y;
+		Fp::sub(R.y, U1, H3);
+		R.x = X3;
+#elif MIE_EC_COORD == MIE_EC_USE_PROJ
+		assert(Q.z == 1);
+		Fp r, u, v, A, vv;
+		Fp::mul(A, Q.y, P.z);
+		Fp::mul(v, Q.x, P.z);
+		v -= P.x;
+		if (v.isZero()) {
+			Fp::add(vv, A, P.y);
+			if (vv.isZero()) {
+				R.clear();
+			} else {
+				dbl(R, P, false);
+			}
+			return;
+		}
+		Fp::sub(u, A, P.y);
+		Fp::square(A, u);
+		Fp::square(vv, v);
+		Fp::mul(r, P.x, vv);
+		vv *= v;
+		A *= P.z;
+		Fp::mul(R.z, P.z, vv);
+		A -= vv;
+		Field::sub2(A, A, r);
+		Fp::mul(R.x, v, A);
+		vv *= P.y;
+		r -= A;
+		Fp::mul(R.y, u, r);
+		R.y -= vv;
+#else
+		add(R, P, Q);
 #endif
 	}
 	static inline void sub(EcT& R, const EcT& P, const EcT& Q)
@@ -363,10 +467,145 @@ public:
 		R.z = P.z;
 #endif
 	}
+	/*
+		z = y x by width-w NAF
+		tbl[i] = (2i + 1) x for i < 2^(w-2) in affine coordinates
+		naf and tbl are on the stack, so y longer than maxNafBitLen bits
+		falls back to the binary method
+	*/
+	static const size_t maxNafBitLen = 1024;
 	template<class N>
 	static inline void power(EcT& z, const EcT& x, const N& y)
 	{
-		power_impl::power(z, x, y);
+		if (y == 0 || x.isZero()) {
+			z.clear();
+			return;
+		}
+		const bool isNegative = y < 0;
+		const N& absY = isNegative ? -y : y;
+		const size_t bitLen = power_impl::getBitLen(absY);
+		if (bitLen > maxNafBitLen) {
+			power_impl::power(z, x, y);
+			return;
+		}
+		const size_t w = power_impl::getNafWindowSize(bitLen);
+		int naf[maxNafBitLen + 1];
+		const size_t nafN = power_impl::getNaf(naf, absY, w);
+		const size_t tblN = size_t(1) << (w - 2);
+		const size_t maxTblN = size_t(1) << (power_impl::maxNafW - 2);
+		EcT tbl[maxTblN];
+		Fp c[maxTblN];
+		tbl[0] = x;
+		if (tblN > 1) {
+			EcT x2;
+			dbl(x2, x);
+			for (size_t i = 1; i < tblN; i++) {
+				add(tbl[i], tbl[i - 1], x2);
+			}
+		}
+		normalizeVec(tbl, tblN, c);
+		EcT t, nP;
+		int d = naf[nafN - 1];
+		if (d > 0) {
+			t = tbl[d >> 1];
+		} else {
+			neg(t, tbl[(-d) >> 1]);
+		}
+		for (size_t i = nafN - 1; i > 0; i--) {
+			dbl(t, t);
+			d = naf[i - 1];
+			if (d > 0) {
+				addMixed(t, t, tbl[d >> 1]);
+			} else if (d < 0) {
+				neg(nP, tbl[(-d) >> 1]);
+				addMixed(t, t, nP);
+			}
+		}
+		if (isNegative) {
+			neg(z, t);
+		} else {
+			z = t;
+		}
+	}
+	/*
+		z = sum_{i < n} y[i] P[i] by the bucket method (Pippenger)
+		each w-bit window adds the affine points into 2^w - 1 buckets
+		and sums the buckets with 2^(w+1) additions
+		the windows are processed in parallel if compiled with OpenMP
+	*/
+	template<class N>
+	static inline void mulVec(EcT& z, const EcT *P, const N *y, size_t n)
+	{
+		if (n < 8) {
+			EcT s, t;
+			for (size_t i = 0; i < n; i++) {
+				power(t, P[i], y[i]);
+				add(s, s, t);
+			}
+			z = s;
+			return;
+		}
+		std::vector<EcT> Q(n);
+		std::vector<N> absY(n);
+		size_t bitLen = 0;
+		for (size_t i = 0; i < n; i++) {
+			if (y[i] < 0) {
+				absY[i] = -y[i];
+				neg(Q[i], P[i]);
+			} else {
+				absY[i] = y[i];
+				Q[i] = P[i];
+			}
+			const size_t len = power_impl::getBitLen(absY[i]);
+			if (len > bitLen) bitLen = len;
+		}
+		if (bitLen == 0) {
+			z.clear();
+			return;
+		}
+		std::vector<Fp> c(n);
+		normalizeVec(&Q[0], n, &c[0]);
+		size_t w = cybozu::bsr(n);
+		w = w < 4 ? 2 : w - 2;
+		if (w > 16) w = 16;
+		const int winN = int((bitLen + w - 1) / w);
+		const size_t bucketN = (size_t(1) << w) - 1;
+		std::vector<EcT> win(winN);
+#ifdef _OPENMP
+		#pragma omp parallel
+#endif
+		{
+			std::vector<EcT> bucket(bucketN); // one per thread, cleared for each window
+#ifdef _OPENMP
+			#pragma omp for
+#endif
+			for (int k = 0; k < winN; k++) {
+				for (size_t j = 0; j < bucketN; j++) {
+					bucket[j].clear();
+				}
+				for (size_t i = 0; i < n; i++) {
+					size_t v = 0;
+					for (size_t j = 0; j < w; j++) {
+						if (power_impl::getBit(absY[i], k * w + j)) v |= size_t(1) << j;
+					}
+					if (v) addMixed(bucket[v - 1], bucket[v - 1], Q[i]);
+				}
+				EcT s, t;
+				for (size_t j = bucketN; j > 0; j--) {
+					add(s, s, bucket[j - 1]);
+					add(t, t, s);
+				}
+				win[k] = t;
+			}
+		}
+		EcT t = win[winN - 1];
+		for (int k = winN - 1; k > 0; k--) {
+			for (size_t j = 0; j < w; j++) {
+				dbl(t, t);
+			}
+			add(t, t, win[k - 1]);
+		}
+		z = t;
 	}
 	/*
 		0 <= P for any P
@@ -394,6 +633,82 @@ public:
 		return z.isZero();
 #endif
 	}
+	/*
+		fixed size of serialize in bytes
+		uncompressed form : [header:1][x:Fp::getByteSize()][y:Fp::getByteSize()]
+		header = 1 for a point, 0 for zero (x and y are filled with 0)
+		x and y are little endian as Fp::serialize, so the SEC1 tag 4 is not used
+	*/
+	static inline size_t getByteSize() { return 1 + Fp::getByteSize() * 2; }
+	size_t serialize(void *buf, size_t maxBufSize) const
+	{
+		const size_t byteSize = getByteSize();
+		if (maxBufSize < byteSize) throw cybozu::Exception("EcT:serialize:small buffer") << maxBufSize << byteSize;
+		char *p = (char*)buf;
+		if (isZero()) {
+			memset(p, 0, byteSize);
+			return byteSize;
+		}
+		normalize();
+		p[0] = 1;
+		p++;
+		p += x.serialize(p, Fp::getByteSize());
+		y.serialize(p, Fp::getByteSize());
+		return byteSize;
+	}
+	/*
+		throw if the point is not on the curve and verify is true
+	*/
+	size_t deserialize(const void *buf, size_t bufSize, bool verify = true)
+	{
+		const size_t byteSize = getByteSize();
+		if (bufSize < byteSize) throw cybozu::Exception("EcT:deserialize:small buffer") << bufSize << byteSize;
+		const char *p = (const char*)buf;
+		switch (p[0]) {
+		case 0:
+			clear();
+			return byteSize;
+		case 1:
+			{
+				Fp _x, _y;
+				p++;
+				p += _x.deserialize(p, Fp::getByteSize());
+				_y.deserialize(p, Fp::getByteSize());
+				set(_x, _y, verify);
+			}
+			return byteSize;
+		default:
+			throw cybozu::Exception("EcT:deserialize:bad header") << int(p[0]);
+		}
+	}
+	static size_t serializeVec(void *buf, size_t maxBufSize, const EcT *P, size_t n)
+	{
+		const size_t byteSize = getByteSize();
+		if (maxBufSize / byteSize < n) throw cybozu::Exception("EcT:serializeVec:small buffer") << maxBufSize << n;
+		char *p = (char*)buf;
+		const size_t blockN = 16; // normalize copies of P block by block
+		EcT Q[blockN];
+		Fp c[blockN];
+		for (size_t i = 0; i < n; i += blockN) {
+			const size_t m = n - i < blockN ? n - i : blockN;
+			for (size_t j = 0; j < m; j++) Q[j] = P[i + j];
+			normalizeVec(Q, m, c);
+			for (size_t j = 0; j < m; j++) {
+				p += Q[j].serialize(p, byteSize);
+			}
+		}
+		return byteSize * n;
+	}
+	static size_t deserializeVec(EcT *P, size_t n, const void *buf, size_t bufSize, bool verify = true)
+	{
+		const size_t byteSize = getByteSize();
+		if (bufSize / byteSize < n) throw cybozu::Exception("EcT:deserializeVec:small buffer") << bufSize << n;
+		const char *p = (const char*)buf;
+		for (size_t i = 0; i < n; i++) {
+			p += P[i].deserialize(p, byteSize, verify);
+		}
+		return byteSize * n;
+	}
 	friend inline std::ostream& operator<<(std::ostream& os, const EcT& self)
 	{
 		if (self.isZero()) {
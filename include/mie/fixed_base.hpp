@@ -0,0 +1,169 @@
+#pragma once
+/**
+	@file
+	@brief fixed-base scalar multiplication of elliptic curve
+	@author MITSUNARI Shigeo(@herumi)
+	@license modified new BSD license
+	http://opensource.org/licenses/BSD-3-Clause
+*/
+#include <vector>
+#include <cybozu/exception.hpp>
+#include <mie/ec.hpp>
+#include <mie/gmp_util.hpp>
+
+namespace mie {
+
+/*
+	precomputed table of a fixed point G
+	tbl[i * tblN + j] = (j + 1) 2^(w i) G in affine coordinates
+	for i < d = ceil((bitLen + 1) / w) and j < tblN = 2^(w-1)
+	y G = sum_i e_i 2^(w i) G with signed digits -2^(w-1) < e_i <= 2^(w-1)
+	so mulGenerator needs at most d additions and no doubling
+	the table is built by the first mulGenerator or serialize
+	(call build() before sharing the object among threads)
+*/
+template<class Ec>
+class EcFixedBaseT {
+	typedef typename Ec::Fp Fp;
+	static const size_t maxW = 8;
+	static const size_t headerSize = 4;
+	mutable std::vector<Ec> tbl_;
+	Ec G_;
+	size_t bitLen_; // max bit length of scalars
+	size_t w_;
+	size_t d_;
+	size_t getTblN() const { return size_t(1) << (w_ - 1); }
+	void set(size_t bitLen, size_t w)
+	{
+		if (bitLen == 0 || bitLen > 0xffff) throw cybozu::Exception("EcFixedBaseT:bad bitLen") << bitLen;
+		if (w < 2 || w > maxW) throw cybozu::Exception("EcFixedBaseT:bad w") << w;
+		bitLen_ = bitLen;
+		w_ = w;
+		d_ = (bitLen + w) / w;
+	}
+public:
+	EcFixedBaseT() : bitLen_(0), w_(0), d_(0) {}
+	/*
+		G : base point
+		bitLen : max bit length of scalars
+		w : window size (0 : choose by bitLen)
+	*/
+	void init(const Ec& G, size_t bitLen, size_t w = 0)
+	{
+		if (w == 0) w = bitLen < 128 ? 4 : 6;
+		set(bitLen, w);
+		G_ = G;
+		tbl_.clear();
+	}
+	/*
+		G = (gx, gy) and bitLen = bit length of n
+		Ec::setParam(para.a, para.b) must be called before
+	*/
+	void init(const EcParam& para, size_t w = 0)
+	{
+		mpz_class n;
+		if (!Gmp::fromStr(n, para.n)) throw cybozu::Exception("EcFixedBaseT:init:bad n") << para.n;
+		init(Ec(Fp(para.gx), Fp(para.gy)), Gmp::getBitLen(n), w);
+	}
+	bool isBuilt() const { return !tbl_.empty(); }
+	void build() const
+	{
+		if (isBuilt()) return;
+		if (d_ == 0) throw cybozu::Exception("EcFixedBaseT:build:not initialized");
+		const size_t tblN = getTblN();
+		tbl_.resize(d_ * tblN);
+		Ec B = G_;
+		for (size_t i = 0; i < d_; i++) {
+			Ec *t = &tbl_[i * tblN];
+			t[0] = B;
+			Ec::dbl(t[1], B);
+			for (size_t j = 2; j < tblN; j++) {
+				Ec::add(t[j], t[j - 1], B);
+			}
+			Ec::dbl(B, t[tblN - 1]);
+		}
+		std::vector<Fp> c(tbl_.size());
+		Ec::normalizeVec(&tbl_[0], tbl_.size(), &c[0]);
+	}
+	/*
+		z = y G
+		throw if the bit length of |y| exceeds bitLen
+	*/
+	template<class N>
+	void mulGenerator(Ec& z, const N& y) const
+	{
+		build();
+		if (y == 0) {
+			z.clear();
+			return;
+		}
+		const bool isNegative = y < 0;
+		const N& absY = isNegative ? -y : y;
+		const size_t bitLen = power_impl::getBitLen(absY);
+		if (bitLen > bitLen_) throw cybozu::Exception("EcFixedBaseT:mulGenerator:too large") << bitLen << bitLen_;
+		const size_t tblN = getTblN();
+		const int half = 1 << (w_ - 1);
+		Ec t, nP;
+		int c = 0; // carry
+		for (size_t i = 0; i < d_; i++) {
+			int v = c;
+			for (size_t j = 0; j < w_; j++) {
+				if (power_impl::getBit(absY, i * w_ + j)) v += 1 << j;
+			}
+			if (v > half) {
+				v -= 1 << w_;
+				c = 1;
+			} else {
+				c = 0;
+			}
+			if (v > 0) {
+				Ec::addMixed(t, t, tbl_[i * tblN + v - 1]);
+			} else if (v < 0) {
+				Ec::neg(nP, tbl_[i * tblN - v - 1]);
+				Ec::addMixed(t, t, nP);
+			}
+		}
+		assert(c == 0);
+		if (isNegative) {
+			Ec::neg(z, t);
+		} else {
+			z = t;
+		}
+	}
+	/*
+		serialized table for fast startup
+		[w:1][0:1][bitLen:2 (little endian)][tbl:Ec::serializeVec]
+	*/
+	size_t getByteSize() const { return headerSize + d_ * getTblN() * Ec::getByteSize(); }
+	size_t serialize(void *buf, size_t maxBufSize) const
+	{
+		build();
+		const size_t byteSize = getByteSize();
+		if (maxBufSize < byteSize) throw cybozu::Exception("EcFixedBaseT:serialize:small buffer") << maxBufSize << byteSize;
+		unsigned char *p = (unsigned char*)buf;
+		p[0] = (unsigned char)w_;
+		p[1] = 0;
+		p[2] = (unsigned char)bitLen_;
+		p[3] = (unsigned char)(bitLen_ >> 8);
+		Ec::serializeVec(p + headerSize, maxBufSize - headerSize, &tbl_[0], tbl_.size());
+		return byteSize;
+	}
+	/*
+		verify : check that every point is on the curve
+	*/
+	size_t deserialize(const void *buf, size_t bufSize, bool verify = true)
+	{
+		if (bufSize < headerSize) throw cybozu::Exception("EcFixedBaseT:deserialize:small buffer") << bufSize;
+		const unsigned char *p = (const unsigned char*)buf;
+		if (p[1] != 0) throw cybozu::Exception("EcFixedBaseT:deserialize:bad header") << int(p[1]);
+		set(p[2] | (size_t(p[3]) << 8), p[0]);
+		const size_t byteSize = getByteSize();
+		if (bufSize < byteSize) throw cybozu::Exception("EcFixedBaseT:deserialize:small buffer") << bufSize << byteSize;
+		tbl_.resize(d_ * getTblN());
+		Ec::deserializeVec(&tbl_[0], tbl_.size(), p + headerSize, bufSize - headerSize, verify);
+		G_ = tbl_[0];
+		return byteSize;
+	}
+};
+
+} // mie
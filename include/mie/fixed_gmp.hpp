@@ -0,0 +1,200 @@
+#pragma once
+/**
+	@file
+	@brief ImplType of FpT with N fixed limbs by mpn functions of gmp
+	@author MITSUNARI Shigeo(@herumi)
+	@license modified new BSD license
+	http://opensource.org/licenses/BSD-3-Clause
+
+	@note there is no memory allocation except for string conversion
+*/
+#include <string.h>
+#include <cybozu/exception.hpp>
+#include <cybozu/bit_operation.hpp>
+#include <mie/gmp_util.hpp>
+#include <mie/fp.hpp>
+
+namespace mie {
+
+/*
+	the modulus must be less than 2^(N * GMP_LIMB_BITS)
+	the values are always in [0, m) and have N limbs
+	typedef mie::FpT<mie::FixedGmp<4> > Fp;
+*/
+template<size_t N>
+struct FixedGmp {
+	typedef mp_limb_t BlockType;
+	struct ImplType {
+		mp_limb_t v[N];
+	};
+	template<class T>
+	static void setRaw(ImplType& z, const T *buf, size_t n)
+	{
+		if (sizeof(T) * n > sizeof(z.v)) throw cybozu::Exception("FixedGmp:setRaw:too large") << n;
+		fp::copyFromLE(z.v, N, buf, sizeof(T) * n);
+	}
+	static inline void set(ImplType& z, uint64_t x)
+	{
+		setRaw(z, &x, 1);
+	}
+	static inline void set(ImplType& z, int x)
+	{
+		assert(x >= 0);
+		set(z, uint64_t(x));
+	}
+	static inline bool fromStr(ImplType& z, const std::string& str, int base = 0)
+	{
+		mpz_class t;
+		if (!Gmp::fromStr(t, str, base)) return false;
+		if (Gmp::isNegative(t)) return false;
+		return Gmp::getRaw(z.v, N, t) != 0;
+	}
+	static inline void toStr(std::string& str, const ImplType& x, int base = 10)
+	{
+		mpz_class t;
+		Gmp::setRaw(t, x.v, N);
+		Gmp::toStr(str, t, base);
+	}
+	static inline void clear(ImplType& z)
+	{
+		for (size_t i = 0; i < N; i++) z.v[i] = 0;
+	}
+	static inline bool isZero(const ImplType& x)
+	{
+		for (size_t i = 0; i < N; i++) {
+			if (x.v[i]) return false;
+		}
+		return true;
+	}
+	static inline int compare(const ImplType& x, const ImplType& y)
+	{
+		return mpn_cmp(x.v, y.v, N);
+	}
+	static inline int compare(const ImplType& x, int y)
+	{
+		ImplType t;
+		set(t, y);
+		return compare(x, t);
+	}
+	static inline void sub(ImplType& z, const ImplType& x, const ImplType& y)
+	{
+		mpn_sub_n(z.v, x.v, y.v, N);
+	}
+	static inline void sub(ImplType& z, const ImplType& x, unsigned int y)
+	{
+		mpn_sub_1(z.v, x.v, N, y);
+	}
+	static inline void shr(ImplType& z, const ImplType& x, size_t n)
+	{
+		const size_t q = n / GMP_NUMB_BITS;
+		const size_t r = n % GMP_NUMB_BITS;
+		if (q >= N) {
+			clear(z);
+			return;
+		}
+		if (r) {
+			mpn_rshift(z.v, x.v + q, N - q, (unsigned int)r);
+		} else {
+			for (size_t i = 0; i < N - q; i++) z.v[i] = x.v[i + q];
+		}
+		for (size_t i = N - q; i < N; i++) z.v[i] = 0;
+	}
+	static inline void addMod(ImplType& z, const ImplType& x, const ImplType& y, const ImplType& m)
+	{
+		const mp_limb_t c = mpn_add_n(z.v, x.v, y.v, N);
+		if (c || compare(z, m) >= 0) mpn_sub_n(z.v, z.v, m.v, N);
+	}
+	static inline void addMod(ImplType& z, const ImplType& x, unsigned int y, const ImplType& m)
+	{
+		const mp_limb_t c = mpn_add_1(z.v, x.v, N, y);
+		if (c || compare(z, m) >= 0) mpn_sub_n(z.v, z.v, m.v, N);
+	}
+	static inline void subMod(ImplType& z, const ImplType& x, const ImplType& y, const ImplType& m)
+	{
+		if (mpn_sub_n(z.v, x.v, y.v, N)) mpn_add_n(z.v, z.v, m.v, N);
+	}
+	static inline void subMod(ImplType& z, const ImplType& x, unsigned int y, const ImplType& m)
+	{
+		if (mpn_sub_1(z.v, x.v, N, y)) mpn_add_n(z.v, z.v, m.v, N);
+	}
+	static inline void mulMod(ImplType& z, const ImplType& x, const ImplType& y, const ImplType& m)
+	{
+		mp_limb_t t[N * 2];
+		mpn_mul_n(t, x.v, y.v, N);
+		mod(z, t, N * 2, m);
+	}
+	static inline void mulMod(ImplType& z, const ImplType& x, unsigned int y, const ImplType& m)
+	{
+		mp_limb_t t[N + 1];
+		t[N] = mpn_mul_1(t, x.v, N, y);
+		mod(z, t, N + 1, m);
+	}
+	static inline void squareMod(ImplType& z, const ImplType& x, const ImplType& m)
+	{
+		mp_limb_t t[N * 2];
+		mpn_sqr(t, x.v, N);
+		mod(z, t, N * 2, m);
+	}
+	/*
+		z = 1 / x mod m by mpn_gcdext (z = 0 if x = 0)
+	*/
+	static inline void invMod(ImplType& z, const ImplType& x, const ImplType& m)
+	{
+		if (isZero(x)) {
+			clear(z);
+			return;
+		}
+		const size_t mn = getBlockSize(m);
+		// mpn_gcdext destroys the inputs and needs one more limb
+		mp_limb_t u[N + 1], v[N + 1], g[N], s[N + 1];
+		for (size_t i = 0; i < mn; i++) {
+			u[i] = x.v[i];
+			v[i] = m.v[i];
+		}
+		mp_size_t sn;
+		mpn_gcdext(g, s, &sn, u, mn, v, mn); // g = x s + m t
+		if (sn < 0) {
+			mpn_sub(z.v, m.v, mn, s, -sn);
+		} else {
+			for (size_t i = 0; i < size_t(sn); i++) z.v[i] = s[i];
+			for (size_t i = sn; i < mn; i++) z.v[i] = 0;
+		}
+		for (size_t i = mn; i < N; i++) z.v[i] = 0;
+	}
+	static inline size_t getBitLen(const ImplType& x)
+	{
+		const size_t n = getBlockSize(x);
+		if (n == 0) return 1;
+		return (n - 1) * GMP_NUMB_BITS + cybozu::bsr(x.v[n - 1]) + 1;
+	}
+	static inline BlockType getBlock(const ImplType& x, size_t i)
+	{
+		return x.v[i];
+	}
+	static inline const BlockType *getBlock(const ImplType& x)
+	{
+		return x.v;
+	}
+	/*
+		the number of limbs without leading zeros
+	*/
+	static inline size_t getBlockSize(const ImplType& x)
+	{
+		size_t n = N;
+		while (n > 0 && x.v[n - 1] == 0) n--;
+		return n;
+	}
+private:
+	/*
+		z = t[0, tn) mod m
+	*/
+	static inline void mod(ImplType& z, const mp_limb_t *t, size_t tn, const ImplType& m)
+	{
+		const size_t mn = getBlockSize(m);
+		mp_limb_t q[N * 2];
+		mpn_tdiv_qr(q, z.v, 0, t, tn, m.v, mn);
+		for (size_t i = mn; i < N; i++) z.v[i] = 0;
+	}
+};
+
+} // mie
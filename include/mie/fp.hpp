@@ -7,12 +7,14 @@
 	http://opensource.org/licenses/BSD-3-Clause
 */
 #include <sstream>
+#include <string.h>
 #include <vector>
 #include <cybozu/hash.hpp>
 #include <cybozu/itoa.hpp>
 #include <cybozu/atoi.hpp>
 #include <mie/operator.hpp>
 #include <mie/power.hpp>
+#include <mie/sqrt.hpp>
 
 namespace mie {
 
@@ -106,6 +108,96 @@ void fromStr16(T *x, size_t xn, const char *str, size_t strLen)
 	for (size_t i = requireSize; i < xn; i++) x[i] = 0;
 }
 
+/*
+	convert x[0..n) to decimal string (n <= maxN)
+	divide x by 10^9 repeatedly in 32-bit units and the active length of x shrinks as it goes
+	(no 128-bit integer and no memory allocation except str)
+*/
+template<size_t maxN>
+void toStr10(std::string& str, const uint64_t *x, size_t n)
+{
+	assert(n <= maxN);
+	const uint32_t d = 1000000000; // 10^9
+	const size_t unitLen = 9;
+	uint32_t t[maxN * 2];
+	for (size_t i = 0; i < n; i++) {
+		t[i * 2] = uint32_t(x[i]);
+		t[i * 2 + 1] = uint32_t(x[i] >> 32);
+	}
+	n *= 2;
+	while (n > 0 && t[n - 1] == 0) n--;
+	uint32_t rem[maxN * 64 / 29 + 1]; // remainders by 10^9 from the bottom ; 10^9 > 2^29
+	size_t remN = 0;
+	while (n > 0) {
+		uint32_t r = 0;
+		for (size_t i = n; i > 0; i--) {
+			const uint64_t v = (uint64_t(r) << 32) | t[i - 1];
+			t[i - 1] = uint32_t(v / d);
+			r = uint32_t(v % d);
+		}
+		rem[remN++] = r;
+		if (t[n - 1] == 0) n--;
+	}
+	if (remN == 0) {
+		str = "0";
+		return;
+	}
+	size_t topLen = 0;
+	for (uint32_t v = rem[remN - 1]; v; v /= 10) topLen++;
+	str.resize(topLen + (remN - 1) * unitLen);
+	char *p = &str[0];
+	for (size_t i = remN; i > 0; i--) {
+		const size_t len = i == remN ? topLen : unitLen;
+		uint32_t v = rem[i - 1];
+		for (size_t j = len; j > 0; j--) {
+			p[j - 1] = char('0' + v % 10);
+			v /= 10;
+		}
+		p += len;
+	}
+}
+
+/*
+	convert decimal string to x[0..xn)
+	decimal string = [0-9]+
+	x = x * 10^9 + (next 9 digits) in 32-bit halves of each limb
+*/
+inline void fromStr10(uint64_t *x, size_t xn, const char *str, size_t strLen)
+{
+	if (strLen == 0) throw cybozu::Exception("fp:fromStr10:strLen is zero");
+	const size_t unitLen = 9;
+	for (size_t i = 0; i < xn; i++) x[i] = 0;
+	size_t n = 0; // active length of x
+	size_t len = strLen % unitLen;
+	if (len == 0) len = unitLen;
+	uint64_t unit = 1;
+	for (size_t i = 0; i < len; i++) unit *= 10;
+	while (strLen > 0) {
+		uint64_t v = 0;
+		for (size_t i = 0; i < len; i++) {
+			const char c = str[i];
+			if (c < '0' || c > '9') throw cybozu::Exception("fp:fromStr10:bad char") << cybozu::exception::makeString(str, strLen);
+			v = v * 10 + (c - '0');
+		}
+		str += len;
+		strLen -= len;
+		// x = x * unit + v ; unit, v, c < 2^30
+		uint64_t c = v;
+		for (size_t i = 0; i < n; i++) {
+			const uint64_t L = (x[i] & 0xffffffff) * unit + c;
+			const uint64_t H = (x[i] >> 32) * unit + (L >> 32);
+			x[i] = (H << 32) | (L & 0xffffffff);
+			c = H >> 32;
+		}
+		if (c) {
+			if (n == xn) throw cybozu::Exception("fp:fromStr10:too large") << xn;
+			x[n++] = c;
+		}
+		len = unitLen;
+		unit = 1000000000;
+	}
+}
+
 /*
 	@param base [inout]
 */
@@ -172,6 +264,77 @@ void setMaskedRaw(std::vector<S>& buf, const S *inBuf, size_t n, size_t bitLen)
 	fp::maskBuffer(&buf[0], buf.size(), bitLen);
 }
 
+/*
+	buf[0, byteSize) = x (n limbs) in little endian
+	x must be less than 2^(byteSize * 8)
+	@note assume a little endian cpu
+*/
+template<class T>
+void copyToLE(void *buf, size_t byteSize, const T *x, size_t n)
+{
+	const size_t xByte = std::min(byteSize, n * sizeof(T));
+	memcpy(buf, x, xByte);
+	memset((char*)buf + xByte, 0, byteSize - xByte);
+}
+
+/*
+	x (n limbs) = buf[0, byteSize) in little endian
+	byteSize must be at most n * sizeof(T)
+*/
+template<class T>
+void copyFromLE(T *x, size_t n, const void *buf, size_t byteSize)
+{
+	assert(byteSize <= n * sizeof(T));
+	memset(x, 0, n * sizeof(T));
+	memcpy(x, buf, byteSize);
+}
+
+/*
+	y[i] = 1 / x[i] for i < n by Montgomery's trick (y may be x)
+	one inversion and 3(n - 1) multiplications
+	y[i] = 0 if x[i] = 0, and zero does not affect the others
+	y keeps the prefix products, so y = x is done on a copy of x
+	(the backward pass needs both x[i] and the products)
+*/
+template<class F>
+void invVec(F *y, const F *x, size_t n)
+{
+	if (n == 0) return;
+	if (y == x) {
+		const std::vector<F> t(x, x + n);
+		invVec(y, &t[0], n);
+		return;
+	}
+	// y[i] = x[0] x[1] ... x[i] skipping zero
+	if (x[0].isZero()) {
+		y[0] = 1;
+	} else {
+		y[0] = x[0];
+	}
+	for (size_t i = 1; i < n; i++) {
+		if (x[i].isZero()) {
+			y[i] = y[i - 1];
+		} else {
+			F::mul(y[i], y[i - 1], x[i]);
+		}
+	}
+	F r;
+	F::inv(r, y[n - 1]);
+	for (size_t i = n - 1; i > 0; i--) {
+		if (x[i].isZero()) {
+			y[i].clear();
+			continue;
+		}
+		F::mul(y[i], r, y[i - 1]);
+		F::mul(r, r, x[i]);
+	}
+	if (x[0].isZero()) {
+		y[0].clear();
+	} else {
+		y[0] = r;
+	}
+}
+
 } // fp
 
 namespace fp_local {
@@ -198,9 +361,9 @@ public:
 	FpT& operator=(int x)
 	{
 		if (x >= 0) {
-			v = x;
+			T::set(v, x);
 		} else {
-			assert(m_ >= -x);
+			assert(T::compare(m_, -x) >= 0);
 			T::sub(v, m_, -x);
 		}
 		return *this;
@@ -214,7 +377,7 @@ public:
 	{
 		bool isMinus;
 		inFromStr(v, &isMinus, str, base);
-		if (v >= m_) throw cybozu::Exception("fp:FpT:fromStr:large str") << str;
+		if (T::compare(v, m_) >= 0) throw cybozu::Exception("fp:FpT:fromStr:large str") << str;
 		if (isMinus) {
 			neg(*this, *this);
 		}
@@ -242,6 +405,55 @@ public:
 		toStr(str, base, withPrefix);
 		return str;
 	}
+	/*
+		fixed size of serialize in bytes
+	*/
+	static inline size_t getByteSize() { return (modBitLen_ + 7) / 8; }
+	/*
+		write getByteSize() bytes of x in little endian to buf and return the size
+	*/
+	size_t serialize(void *buf, size_t maxBufSize) const
+	{
+		const size_t byteSize = getByteSize();
+		if (maxBufSize < byteSize) throw cybozu::Exception("fp:FpT:serialize:small buffer") << maxBufSize << byteSize;
+		fp::copyToLE(buf, byteSize, getBlock(*this), getBlockSize(*this));
+		return byteSize;
+	}
+	/*
+		read getByteSize() bytes from buf and return the size
+		throw if the value is not less than the modulus
+	*/
+	size_t deserialize(const void *buf, size_t bufSize)
+	{
+		const size_t byteSize = getByteSize();
+		if (bufSize < byteSize) throw cybozu::Exception("fp:FpT:deserialize:small buffer") << bufSize << byteSize;
+		T::setRaw(v, (const uint8_t*)buf, byteSize);
+		if (T::compare(v, m_) >= 0) throw cybozu::Exception("fp:FpT:deserialize:too large");
+		return byteSize;
+	}
+	/*
+		serialize x[0], ..., x[n - 1] to contiguous buf and return the total size
+	*/
+	static size_t serializeVec(void *buf, size_t maxBufSize, const FpT *x, size_t n)
+	{
+		const size_t byteSize = getByteSize();
+		if (maxBufSize / byteSize < n) throw cybozu::Exception("fp:FpT:serializeVec:small buffer") << maxBufSize << n;
+		char *p = (char*)buf;
+		for (size_t i = 0; i < n; i++) {
+			p += x[i].serialize(p, byteSize);
+		}
+		return byteSize * n;
+	}
+	static size_t deserializeVec(FpT *x, size_t n, const void *buf, size_t bufSize)
+	{
+		const size_t byteSize = getByteSize();
+		if (bufSize / byteSize < n) throw cybozu::Exception("fp:FpT:deserializeVec:small buffer") << bufSize << n;
+		const char *p = (const char*)buf;
+		for (size_t i = 0; i < n; i++) {
+			p += x[i].deserialize(p, byteSize);
+		}
+		return byteSize * n;
+	}
 	void clear()
 	{
 		T::clear(v);
@@ -275,6 +487,7 @@ public:
 		if (isMinus) throw cybozu::Exception("fp:FpT:setModulo:mstr is not minus") << mstr;
 		modBitLen_ = T::getBitLen(m_);
 		opt_.init(m_);
+		sq_.init(T::getBlock(m_), T::getBlockSize(m_));
 	}
 	static inline void getModulo(std::string& mstr)
 	{
@@ -290,7 +503,14 @@ public:
 			T::mulMod(z.v, x.v, y.v, m_);
 		}
 	}
-	static inline void square(FpT& z, const FpT& x) { T::squareMod(z.v, x.v, m_); }
+	static inline void square(FpT& z, const FpT& x)
+	{
+		if (opt_.hasMulMod()) {
+			opt_.squareMod(z.v, x.v);
+		} else {
+			T::squareMod(z.v, x.v, m_);
+		}
+	}
 
 	static inline void add(FpT& z, const FpT& x, unsigned int y) { T::addMod(z.v, x.v, y, m_); }
 	static inline void sub(FpT& z, const FpT& x, unsigned int y) { T::subMod(z.v, x.v, y, m_); }
@@ -304,11 +524,15 @@ public:
 	}
 
 	static inline void inv(FpT& z, const FpT& x) { T::invMod(z.v, x.v, m_); }
+	/*
+		y[i] = 1 / x[i] for i < n (y[i] = 0 if x[i] = 0)
+	*/
+	static inline void invVec(FpT *y, const FpT *x, size_t n) { fp::invVec(y, x, n); }
 	static inline void div(FpT& z, const FpT& x, const FpT& y)
 	{
-		ImplType rev;
-		T::invMod(rev, y.v, m_);
-		T::mulMod(z.v, x.v, rev, m_);
+		FpT rev;
+		inv(rev, y);
+		mul(z, x, rev);
 	}
 	static inline void neg(FpT& z, const FpT& x)
 	{
@@ -318,6 +542,31 @@ public:
 			T::sub(z.v, m_, x.v);
 		}
 	}
+	/*
+		z = sqrt(x) and return true if x is a square, return false otherwise
+		m_ must be an odd prime
+	*/
+	static inline bool sqrt(FpT& z, const FpT& x) { return sq_.get(z, x); }
+	static inline int legendre(const FpT& x) { return sq_.legendre(x); }
+	/*
+		by the Jacobi symbol without exponentiation
+		on the stack for m_ of at most maxJacobiN blocks, by the Legendre symbol otherwise
+	*/
+	static const size_t maxJacobiN = 16;
+	static inline bool isSquare(const FpT& x)
+	{
+		const size_t n = T::getBlockSize(m_);
+		if (n > maxJacobiN) return legendre(x) >= 0;
+		BlockType a[maxJacobiN], m[maxJacobiN];
+		const BlockType *p = T::getBlock(m_);
+		const BlockType *q = getBlock(x);
+		const size_t xn = getBlockSize(x);
+		for (size_t i = 0; i < n; i++) {
+			a[i] = i < xn ? q[i] : 0;
+			m[i] = p[i];
+		}
+		return fp::jacobi(a, m, n) >= 0;
+	}
 	static inline BlockType getBlock(const FpT& x, size_t i)
 	{
 		return T::getBlock(x.v, i);
@@ -344,7 +593,7 @@ public:
 	}
 	static inline void shr(FpT& z, const FpT& x, size_t n)
 	{
-		z.v = x.v >> n;
+		T::shr(z.v, x.v, n);
 	}
 	bool isZero() const { return isZero(*this); }
 	size_t getBitLen() const { return getBitLen(*this); }
@@ -359,6 +608,7 @@ private:
 	static ImplType m_;
 	static size_t modBitLen_;
 	static mie::ope::Optimized<ImplType> opt_;
+	static fp::SquareRoot<FpT> sq_;
 	ImplType v;
 	static inline void inFromStr(ImplType& t, bool *isMinus, const std::string& str, int base)
 	{
@@ -374,10 +624,10 @@ private:
 		assert(!buf.empty());
 		fp::maskBuffer(&buf[0], buf.size(), modBitLen_);
 		T::setRaw(v, &buf[0], buf.size());
-		if (v >= m_) {
+		if (T::compare(v, m_) >= 0) {
 			T::sub(v, v, m_);
 		}
-		assert(v < m_);
+		assert(T::compare(v, m_) < 0);
 	}
 };
 
@@ -388,6 +638,8 @@ size_t FpT<T, tag>::modBitLen_;
 
 template<class T, class tag>
 mie::ope::Optimized<typename T::ImplType> FpT<T, tag>::opt_;
+template<class T, class tag>
+fp::SquareRoot<FpT<T, tag> > FpT<T, tag>::sq_;
 
 } // mie
 
@@ -162,10 +162,29 @@ struct FpGenerator : Xbyak::CodeGenerator {
 	static const int UseRCX = Xbyak::util::UseRCX;
 	Xbyak::util::Cpu cpu_;
 	bool useMulx_;
+	bool useAdx_; // mul_ and mulVec_ by adcx/adox ; may be cleared before init
 	const uint64_t *p_;
 	uint64_t pp_;
 	int pn_;
+	int elemN_; // limbs per element of xxxVec_ and mulSimd_ (pn_ by default)
 	bool isFullBit_;
+	/*
+		reduction used by mod_ (and mul_ if useSpecialMul())
+		values are kept as xR mod p (R = 2^(64pn)) for every type
+		ModMont : generic montgomery reduction
+		ModPseudoMersenne : p = 2^(64pn) - c (c < 2^48) ; q = t / c mod 2^64 per limb
+		ModMersenne : p = 2^k - 1 (k % 64 != 0) ; x / R = x 2^(k - 64pn) is a rotation of k bits
+		the special reductions are used if useSpecialMod_ is set before init (default)
+	*/
+	enum {
+		ModMont,
+		ModPseudoMersenne,
+		ModMersenne
+	};
+	int modType_;
+	bool useSpecialMod_; // use ModPseudoMersenne or ModMersenne if possible ; true by default
+	uint64_t pmC_; // c of ModPseudoMersenne
+	int msBit_; // k % 64 of ModMersenne
 	// add/sub without carry. return true if overflow
 	typedef bool (*bool3op)(uint64_t*, const uint64_t*, const uint64_t*);
 
@@ -180,53 +199,136 @@ struct FpGenerator : Xbyak::CodeGenerator {
 
 	// preInv
 	typedef int (*int2op)(uint64_t*, const uint64_t*);
+
+	// z[i] = x[i] op y[i] for i < n
+	typedef void (*void3opN)(uint64_t*, const uint64_t*, const uint64_t*, size_t);
+
+	// z[i] = op x[i] for i < n
+	typedef void (*void2opN)(uint64_t*, const uint64_t*, size_t);
+
+	// mul by integer with mod
+	typedef void (*void3opI)(uint64_t*, const uint64_t*, uint64_t);
 	bool3op addNc_;
 	bool3op subNc_;
 	void3op add_;
 	void3op sub_;
 	void3op mul_;
+	void2op sqr_;
 	uint3opI mulI_;
 	void2op neg_;
 	void2op shr1_;
 	int2op preInv_;
-	FpGenerator()
-		: CodeGenerator(4096 * 8)
+	void3opN addVec_;
+	void3opN subVec_;
+	void3opN mulVec_;
+	void2opN negVec_;
+	/*
+		small multiples with mod (0 if pn_ > 9)
+		mulBy2_, mulBy3_, mulBy4_, mulBy8_ ; z = c * x
+		sub2_ ; z = x - 2 * y
+		mulUnit_(z, x, c) ; z = c * x for c < 2^63 (for any pn_)
+	*/
+	void2op mulBy2_;
+	void2op mulBy3_;
+	void2op mulBy4_;
+	void2op mulBy8_;
+	void3op sub2_;
+	void3opI mulUnit_;
+	/*
+		for MontFpDblT (double width values)
+		mulPre_(xy[2n], x[n], y[n]) ; xy = x * y
+		mod_(z[n], xy[2n]) ; z = xy / 2^(64n) mod p for xy < p * 2^(64n)
+		addDbl_, subDbl_ ; mod p * 2^(64n)
+		addDblNc_, subDblNc_ ; without reduction
+	*/
+	void3op mulPre_;
+	void2op mod_;
+	void3op addDbl_;
+	void3op subDbl_;
+	bool3op addDblNc_;
+	bool3op subDblNc_;
+	void3opN mulSimd_; // n is a multiple of simdN_
+	int simdN_; // lanes of mulSimd_ (0 if not available)
+	bool useIfmaSimd_; // make the AVX-512 IFMA mulSimd_ if set before init and the cpu has it ; false by default
+	static const size_t simdTblN = 32 * 8;
+	uint64_t simdTbl_[simdTblN];
+	/*
+		@param maxSize [in] size of the code buffer ; about 2KB per limb is required for pn > 9
+	*/
+	explicit FpGenerator(size_t maxSize = 4096 * 16)
+		: CodeGenerator(maxSize)
 		, p_(0)
 		, pp_(0)
 		, pn_(0)
+		, elemN_(0)
 		, isFullBit_(0)
+		, modType_(ModMont)
+		, useSpecialMod_(true)
+		, pmC_(0)
+		, msBit_(0)
 		, addNc_(0)
 		, subNc_(0)
 		, add_(0)
 		, sub_(0)
 		, mul_(0)
+		, sqr_(0)
 		, mulI_(0)
 		, neg_(0)
 		, shr1_(0)
 		, preInv_(0)
+		, addVec_(0)
+		, subVec_(0)
+		, mulVec_(0)
+		, negVec_(0)
+		, mulBy2_(0)
+		, mulBy3_(0)
+		, mulBy4_(0)
+		, mulBy8_(0)
+		, sub2_(0)
+		, mulUnit_(0)
+		, mulPre_(0)
+		, mod_(0)
+		, addDbl_(0)
+		, subDbl_(0)
+		, addDblNc_(0)
+		, subDblNc_(0)
+		, mulSimd_(0)
+		, simdN_(0)
+		, useIfmaSimd_(false)
 	{
 		useMulx_ = cpu_.has(Xbyak::util::Cpu::tBMI2);
+		useAdx_ = useMulx_ && cpu_.has(Xbyak::util::Cpu::tADX);
 	}
 	/*
 		@param p [in] pointer to prime
 		@param pn [in] length of prime
+		@param elemN [in] stride of the arrays of xxxVec_ in limbs (pn if 0)
 	*/
-	void init(const uint64_t *p, int pn)
+	void init(const uint64_t *p, int pn, int elemN = 0)
 	{
 		if (pn < 2) throw cybozu::Exception("mie:FpGenerator:small pn") << pn;
+		if (elemN == 0) elemN = pn;
+		if (elemN < pn) throw cybozu::Exception("mie:FpGenerator:small elemN") << pn << elemN;
 		p_ = p;
 		pp_ = montgomery::getCoff(p[0]);
 		pn_ = pn;
+		elemN_ = elemN;
 		isFullBit_ = (p_[pn_ - 1] >> 63) != 0;
+		modType_ = (useSpecialMod_ && pn_ <= 9) ? getModType(p_, pn_) : ModMont;
+		if (modType_ == ModPseudoMersenne) pmC_ = 0 - p_[0];
+		if (modType_ == ModMersenne) {
+			msBit_ = 0;
+			while (p_[pn_ - 1] >> msBit_) msBit_++;
+		}
 //		printf("p=%p, pn_=%d, isFullBit_=%d\n", p_, pn_, isFullBit_);
 
 		setSize(0); // reset code
 		align(16);
 		addNc_ = getCurr<bool3op>();
-		gen_addSubNc(true);
+		gen_addSubNc(true, pn_);
 		align(16);
 		subNc_ = getCurr<bool3op>();
-		gen_addSubNc(false);
+		gen_addSubNc(false, pn_);
 		align(16);
 		add_ = getCurr<void3op>();
 		gen_addMod();
@@ -243,18 +345,130 @@ struct FpGenerator : Xbyak::CodeGenerator {
 		mul_ = getCurr<void3op>();
 		gen_mul();
 		align(16);
+		sqr_ = getCurr<void2op>();
+		gen_sqr();
+		align(16);
 		shr1_ = getCurr<void2op>();
 		gen_shr1();
-		preInv_ = getCurr<int2op>();
-		gen_preInv();
+		align(16);
+		addVec_ = getCurr<void3opN>();
+		gen_addVec();
+		align(16);
+		subVec_ = getCurr<void3opN>();
+		gen_subVec();
+		align(16);
+		mulVec_ = getCurr<void3opN>();
+		gen_mul(true);
+		align(16);
+		negVec_ = getCurr<void2opN>();
+		gen_negVec();
+		if (pn_ <= 9) {
+			align(16);
+			mulBy2_ = getCurr<void2op>();
+			gen_mulSmall(2);
+			align(16);
+			mulBy3_ = getCurr<void2op>();
+			gen_mulSmall(3);
+			align(16);
+			mulBy4_ = getCurr<void2op>();
+			gen_mulSmall(4);
+			align(16);
+			mulBy8_ = getCurr<void2op>();
+			gen_mulSmall(8);
+			align(16);
+			sub2_ = getCurr<void3op>();
+			gen_sub2();
+		} else {
+			mulBy2_ = 0;
+			mulBy3_ = 0;
+			mulBy4_ = 0;
+			mulBy8_ = 0;
+			sub2_ = 0;
+		}
+		align(16);
+		mulUnit_ = getCurr<void3opI>();
+		gen_mulUnit();
+		align(16);
+		mulPre_ = getCurr<void3op>();
+		gen_mulPre();
+		align(16);
+		mod_ = getCurr<void2op>();
+		if (isSpecialMod()) {
+			gen_modSpecial();
+		} else {
+			gen_mod();
+		}
+		align(16);
+		addDbl_ = getCurr<void3op>();
+		gen_addDbl();
+		align(16);
+		subDbl_ = getCurr<void3op>();
+		gen_subDbl();
+		align(16);
+		addDblNc_ = getCurr<bool3op>();
+		gen_addSubNc(true, pn_ * 2);
+		align(16);
+		subDblNc_ = getCurr<bool3op>();
+		gen_addSubNc(false, pn_ * 2);
+		if (pn_ <= 9) {
+			preInv_ = getCurr<int2op>();
+			gen_preInv();
+		} else {
+			preInv_ = 0;
+		}
+		if (pn_ <= 9 && useIfmaSimd_ && cpu_.has(Xbyak::util::Cpu::tAVX512F) && cpu_.has(Xbyak::util::Cpu::tAVX512IFMA)) {
+			simdN_ = 8;
+		} else {
+			simdN_ = 0;
+		}
+		if (simdN_) {
+			align(16);
+			mulSimd_ = getCurr<void3opN>();
+			gen_mulSimd();
+		} else {
+			mulSimd_ = 0;
+		}
 	}
-	void gen_addSubNc(bool isAdd)
+	bool isSpecialMod() const { return modType_ != ModMont; }
+	/*
+		mul_ and sqr_ by the special reduction are faster than montgomery ones
+		for ModMersenne and for ModPseudoMersenne with adcx/adox (pn <= 4)
+		otherwise only mod_ uses it
+	*/
+	bool useSpecialMul() const
+	{
+		return modType_ == ModMersenne || (modType_ == ModPseudoMersenne && useAdx_ && pn_ <= 4);
+	}
+	/*
+		p = 2^(64pn) - c (c < 2^48) => ModPseudoMersenne
+		p = 2^k - 1 (k % 64 != 0) => ModMersenne
+		otherwise ModMont
+	*/
+	static int getModType(const uint64_t *p, int pn)
+	{
+		bool isOnes = true;
+		for (int i = 1; i < pn - 1; i++) {
+			if (p[i] != uint64_t(-1)) isOnes = false;
+		}
+		if (!isOnes) return ModMont;
+		const uint64_t top = p[pn - 1];
+		if (top == uint64_t(-1)) {
+			const uint64_t c = 0 - p[0];
+			return (c > 1 && c < (uint64_t(1) << 48)) ? ModPseudoMersenne : ModMont;
+		}
+		if (p[0] == uint64_t(-1) && ((top + 1) & top) == 0) return ModMersenne;
+		return ModMont;
+	}
+	/*
+		n : number of limbs (pn_ or pn_ * 2)
+	*/
+	void gen_addSubNc(bool isAdd, int n)
 	{
 		StackFrame sf(this, 3);
 		if (isAdd) {
-			gen_raw_add(sf.p[0], sf.p[1], sf.p[2], rax);
+			gen_raw_add(sf.p[0], sf.p[1], sf.p[2], rax, n);
 		} else {
-			gen_raw_sub(sf.p[0], sf.p[1], sf.p[2], rax);
+			gen_raw_sub(sf.p[0], sf.p[1], sf.p[2], rax, n);
 		}
 		setc(al);
 		movzx(eax, al);
@@ -263,11 +477,15 @@ struct FpGenerator : Xbyak::CodeGenerator {
 		pz[] = px[] + py[]
 	*/
 	void gen_raw_add(const RegExp& pz, const RegExp& px, const RegExp& py, const Reg64& t)
+	{
+		gen_raw_add(pz, px, py, t, pn_);
+	}
+	void gen_raw_add(const RegExp& pz, const RegExp& px, const RegExp& py, const Reg64& t, int n)
 	{
 		mov(t, ptr [px]);
 		add(t, ptr [py]);
 		mov(ptr [pz], t);
-		for (int i = 1; i < pn_; i++) {
+		for (int i = 1; i < n; i++) {
 			mov(t, ptr [px + i * 8]);
 			adc(t, ptr [py + i * 8]);
 			mov(ptr [pz + i * 8], t);
@@ -277,11 +495,15 @@ struct FpGenerator : Xbyak::CodeGenerator {
 		pz[] = px[] - py[]
 	*/
 	void gen_raw_sub(const RegExp& pz, const RegExp& px, const RegExp& py, const Reg64& t)
+	{
+		gen_raw_sub(pz, px, py, t, pn_);
+	}
+	void gen_raw_sub(const RegExp& pz, const RegExp& px, const RegExp& py, const Reg64& t, int n)
 	{
 		mov(t, ptr [px]);
 		sub(t, ptr [py]);
 		mov(ptr [pz], t);
-		for (int i = 1; i < pn_; i++) {
+		for (int i = 1; i < n; i++) {
 			mov(t, ptr [px + i * 8]);
 			sbb(t, ptr [py + i * 8]);
 			mov(ptr [pz + i * 8], t);
@@ -289,27 +511,28 @@ struct FpGenerator : Xbyak::CodeGenerator {
 	}
 	/*
 		pz[] = -px[]
+		pAddr = p
 	*/
-	void gen_raw_neg(const RegExp& pz, const RegExp& px, const Reg64& t0, const Reg64& t1)
+	void gen_raw_neg(const RegExp& pz, const RegExp& px, const Reg64& t0, const Reg64& pAddr)
 	{
+		const Xbyak::CodeGenerator::LabelType jmpMode = pn_ <= 9 ? T_AUTO : T_NEAR;
 		inLocalLabel();
 		mov(t0, ptr [px]);
 		test(t0, t0);
-		jnz(".neg");
+		jnz(".neg", jmpMode);
 		if (pn_ > 1) {
 			for (int i = 1; i < pn_; i++) {
 				or_(t0, ptr [px + i * 8]);
 			}
-			jnz(".neg");
+			jnz(".neg", jmpMode);
 		}
 		// zero
 		for (int i = 0; i < pn_; i++) {
 			mov(ptr [pz + i * 8], t0);
 		}
-		jmp(".exit");
+		jmp(".exit", jmpMode);
 	L(".neg");
-		mov(t1, (size_t)p_);
-		gen_raw_sub(pz, t1, px, t0);
+		gen_raw_sub(pz, pAddr, px, t0);
 	L(".exit");
 		outLocalLabel();
 	}
@@ -516,67 +739,838 @@ struct FpGenerator : Xbyak::CodeGenerator {
 			gen_subMod_le4(pn_);
 			return;
 		}
-		StackFrame sf(this, 3);
-		const Reg64& pz = sf.p[0];
-		const Reg64& px = sf.p[1];
-		const Reg64& py = sf.p[2];
-		const Xbyak::CodeGenerator::LabelType jmpMode = pn_ < 5 ? T_AUTO : T_NEAR;
-
-		inLocalLabel();
-		gen_raw_sub(pz, px, py, rax);
-		jnc(".exit", jmpMode);
-		mov(px, (size_t)p_);
-		gen_raw_add(pz, pz, px, rax);
+		StackFrame sf(this, 3);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		const Xbyak::CodeGenerator::LabelType jmpMode = pn_ < 5 ? T_AUTO : T_NEAR;
+
+		inLocalLabel();
+		gen_raw_sub(pz, px, py, rax);
+		jnc(".exit", jmpMode);
+		mov(px, (size_t)p_);
+		gen_raw_add(pz, pz, px, rax);
+	L(".exit");
+		outLocalLabel();
+	}
+	void gen_neg()
+	{
+		StackFrame sf(this, 2, 2);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		mov(sf.t[1], (size_t)p_);
+		gen_raw_neg(pz, px, sf.t[0], sf.t[1]);
+	}
+	void gen_shr1()
+	{
+		const int c = 1;
+		StackFrame sf(this, 2, 1);
+		const Reg64 *t0 = &rax;
+		const Reg64 *t1 = &sf.t[0];
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		mov(*t0, ptr [px]);
+		for (int i = 0; i < pn_ - 1; i++) {
+			mov(*t1, ptr [px + 8 * (i + 1)]);
+			shrd(*t0, *t1, c);
+			mov(ptr [pz + i * 8], *t0);
+			std::swap(t0, t1);
+		}
+		shr(*t0, c);
+		mov(ptr [pz + (pn_ - 1) * 8], *t0);
+	}
+	/*
+		t = t - p if t >= p for t < 2p
+		h : top of t if isFullBit_
+		destroy [rsp, rsp + pn_ * 8)
+	*/
+	void condSub_r(const Pack& t, const Reg64& pAddr, const Reg64& h)
+	{
+		store_mr(rsp, t);
+		sub_rm(t, pAddr);
+		if (isFullBit_) sbb(h, 0);
+		for (int i = 0; i < (int)t.size(); i++) {
+			cmovc(t[i], ptr [rsp + i * 8]);
+		}
+	}
+	/*
+		t = 2t mod p
+	*/
+	void twiceMod_r(const Pack& t, const Reg64& pAddr, const Reg64& h)
+	{
+		if (isFullBit_) xor_(h, h);
+		add_rr(t, t);
+		if (isFullBit_) adc(h, 0);
+		condSub_r(t, pAddr, h);
+	}
+	/*
+		t = t + x mod p
+	*/
+	void addMod_rm(const Pack& t, const RegExp& px, const Reg64& pAddr, const Reg64& h)
+	{
+		if (isFullBit_) xor_(h, h);
+		add_rm(t, px);
+		if (isFullBit_) adc(h, 0);
+		condSub_r(t, pAddr, h);
+	}
+	/*
+		t = t - y mod p
+		branchless for pn_ <= 4 as gen_subMod_le4
+		destroy m, [rsp, rsp + pn_ * 8)
+	*/
+	void subMod_rm(const Pack& t, const RegExp& py, const Reg64& pAddr, const Reg64& m)
+	{
+		sub_rm(t, py);
+		if (pn_ > 4) {
+			jnc("@f");
+			add_rm(t, pAddr);
+		L("@@");
+			return;
+		}
+		sbb(m, m); // m = t < y ? -1 : 0
+		store_mr(rsp, t);
+		add_rm(t, pAddr);
+		test(m, m);
+		for (int i = 0; i < (int)t.size(); i++) {
+			cmovz(t[i], ptr [rsp + i * 8]);
+		}
+	}
+	/*
+		z = c * x mod p for c = 2, 3, 4, 8
+		keep x in registers instead of c - 1 calls of add_
+	*/
+	void gen_mulSmall(int c)
+	{
+		assert(pn_ <= 9);
+		assert(c == 2 || c == 3 || c == 4 || c == 8);
+		StackFrame sf(this, 2, pn_ + 1, pn_ * 8);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		Pack t = sf.t.sub(0, pn_);
+		const Reg64& h = sf.t[pn_];
+
+		mov(rax, (size_t)p_);
+		load_rm(t, px);
+		for (int k = (c == 3) ? 2 : c; k > 1; k >>= 1) {
+			twiceMod_r(t, rax, h);
+		}
+		if (c == 3) {
+			addMod_rm(t, px, rax, h);
+		}
+		store_mr(pz, t);
+	}
+	/*
+		z = x - 2y mod p
+	*/
+	void gen_sub2()
+	{
+		assert(pn_ <= 9);
+		StackFrame sf(this, 3, pn_ + 1, pn_ * 8);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		Pack t = sf.t.sub(0, pn_);
+		const Reg64& m = sf.t[pn_];
+
+		mov(rax, (size_t)p_);
+		load_rm(t, px);
+		subMod_rm(t, py, rax, m);
+		subMod_rm(t, py, rax, m);
+		store_mr(pz, t);
+	}
+	/*
+		z = c * x mod p for c < 2^63
+		L = bitLen(p), P = p >> (L - 64), T = (c * x) >> (L - 64)
+		q = T / (P + 1) satisfies c * x - q * p < 2p
+	*/
+	void gen_mulUnit()
+	{
+		const int n = pn_;
+		const int regNum = useMulx_ ? 2 : (1 + std::min(n - 1, 8));
+		const int stackSize = (n + 1) * 8 * 2 + (useMulx_ ? 0 : (n - 1) * 8);
+		StackFrame sf(this, 3, regNum | UseRDX, stackSize);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& y = sf.p[2];
+		const Reg64& t = sf.t[0];
+		const RegExp pt = rsp; // c * x
+		const RegExp pq = rsp + (n + 1) * 8; // q * p
+		size_t rspPos = (n + 1) * 8 * 2;
+		Pack remain = sf.t.sub(1);
+		MixPack wk(remain, rspPos, n - 1);
+
+		gen_raw_mulI(pt, px, y, wk, t, n);
+		mov(ptr [pt + n * 8], rdx);
+		int s = 0;
+		while (((p_[n - 1] << s) >> 63) == 0) s++;
+		uint64_t P = p_[n - 1];
+		if (s) P = (P << s) | (p_[n - 2] >> (64 - s));
+		mov(rax, ptr [pt + (n - 1) * 8]);
+		if (s) {
+			mov(t, ptr [pt + (n - 2) * 8]);
+			shld(rdx, rax, uint8_t(s));
+			shld(rax, t, uint8_t(s));
+		}
+		if (P == uint64_t(-1)) {
+			mov(y, rdx);
+		} else {
+			mov(t, P + 1);
+			div(t);
+			mov(y, rax);
+		}
+		mov(px, (size_t)p_);
+		gen_raw_mulI(pq, px, y, wk, t, n);
+		mov(ptr [pq + n * 8], rdx);
+		for (int i = 0; i <= n; i++) {
+			mov(t, ptr [pt + i * 8]);
+			if (i == 0) {
+				sub(t, ptr [pq]);
+			} else {
+				sbb(t, ptr [pq + i * 8]);
+			}
+			mov(ptr [pt + i * 8], t);
+		}
+		// pq[] = pt[] - p ; the top of pt[] is zero unless isFullBit_
+		for (int i = 0; i < n; i++) {
+			mov(t, ptr [pt + i * 8]);
+			if (i == 0) {
+				sub(t, ptr [px]);
+			} else {
+				sbb(t, ptr [px + i * 8]);
+			}
+			mov(ptr [pq + i * 8], t);
+		}
+		if (isFullBit_) {
+			mov(t, ptr [pt + n * 8]);
+			sbb(t, 0);
+		}
+		for (int i = 0; i < n; i++) {
+			mov(t, ptr [pt + i * 8]);
+			cmovnc(t, ptr [pq + i * 8]);
+			mov(ptr [pz + i * 8], t);
+		}
+	}
+	/*
+		isVec : mulVec_(pz, px, py, n) instead of mul_(pz, px, py)
+	*/
+	void gen_mul(bool isVec = false)
+	{
+		if (useSpecialMul()) {
+			if (modType_ == ModPseudoMersenne) {
+				gen_mulPseudoMersenneAdx(pn_, isVec);
+			} else {
+				gen_mulSpecial(isVec);
+			}
+		} else if (useAdx_ && pn_ <= (isFullBit_ ? 8 : 9)) {
+			gen_montMulAdx(pn_, isVec);
+		} else if (pn_ == 3) {
+			gen_montMul3(p_, pp_, isVec);
+		} else if (pn_ == 4) {
+			gen_montMul4(p_, pp_, isVec);
+		} else if (pn_ <= 9) {
+			gen_montMulN(p_, pp_, pn_, isVec);
+		} else {
+			gen_montMulLoop(p_, pp_, pn_, isVec);
+		}
+	}
+	/*
+		loop header of xxxVec_ ; do nothing if cnt == 0
+	*/
+	void gen_beginVec(const Reg64& cnt)
+	{
+		inLocalLabel();
+		test(cnt, cnt);
+		jz(".exit", T_NEAR);
+	L(".lp");
+	}
+	/*
+		advance pz, px, py (if not null) to the next element and loop while --cnt != 0
+	*/
+	void gen_endVec(const Operand& cnt, const Reg64& pz, const Reg64& px, const Reg64 *py)
+	{
+		add(pz, elemN_ * 8);
+		add(px, elemN_ * 8);
+		if (py) add(*py, elemN_ * 8);
+		dec(cnt);
+		jnz(".lp", T_NEAR);
+	L(".exit");
+		outLocalLabel();
+	}
+	/*
+		pz[i] = (px[i] + py[i]) mod p for i < n
+	*/
+	void gen_addVec()
+	{
+		const int n = pn_;
+		const bool isReg = n <= 4;
+		StackFrame sf(this, 4, isReg ? n * 2 + 2 : 2, isReg ? 0 : n * 8);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		const Reg64& pAddr = sf.t[0];
+		const Reg64& t = sf.t[1];
+
+		mov(pAddr, (size_t)p_);
+		gen_beginVec(sf.p[3]);
+		if (isReg) {
+			Pack rx = sf.t.sub(2, n);
+			Pack rt = sf.t.sub(2 + n, n);
+			if (isFullBit_) xor_(t, t);
+			load_rm(rx, px);
+			add_rm(rx, py);
+			if (isFullBit_) adc(t, 0);
+			mov_rr(rt, rx);
+			sub_rm(rt, pAddr);
+			if (isFullBit_) sbb(t, 0);
+			for (int i = 0; i < n; i++) {
+				cmovc(rt[i], rx[i]);
+			}
+			store_mr(pz, rt);
+		} else {
+			inLocalLabel();
+			gen_raw_add(pz, px, py, t);
+			if (isFullBit_) jc(".over", T_NEAR);
+			gen_raw_sub(rsp, pz, pAddr, t);
+			jc(".next", T_NEAR);
+			gen_mov(pz, rsp, t, n);
+			if (isFullBit_) {
+				jmp(".next", T_NEAR);
+			L(".over");
+				gen_raw_sub(pz, pz, pAddr, t);
+			}
+		L(".next");
+			outLocalLabel();
+		}
+		gen_endVec(sf.p[3], pz, px, &py);
+	}
+	/*
+		pz[i] = (px[i] - py[i]) mod p for i < n
+	*/
+	void gen_subVec()
+	{
+		const int n = pn_;
+		const bool isReg = n <= 4;
+		StackFrame sf(this, 4, isReg ? n * 2 + 2 : 2);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		const Reg64& pAddr = sf.t[0];
+		const Reg64& t = sf.t[1];
+
+		mov(pAddr, (size_t)p_);
+		gen_beginVec(sf.p[3]);
+		if (isReg) {
+			Pack rx = sf.t.sub(2, n);
+			Pack ry = sf.t.sub(2 + n, n);
+			load_rm(rx, px);
+			sub_rm(rx, py);
+			sbb(t, t); // t = (x >= y) ? 0 : -1
+			load_rm(ry, pAddr);
+			for (int i = 0; i < n; i++) {
+				and_(ry[i], t);
+			}
+			add_rr(rx, ry);
+			store_mr(pz, rx);
+		} else {
+			inLocalLabel();
+			gen_raw_sub(pz, px, py, t);
+			jnc(".next", T_NEAR);
+			gen_raw_add(pz, pz, pAddr, t);
+		L(".next");
+			outLocalLabel();
+		}
+		gen_endVec(sf.p[3], pz, px, &py);
+	}
+	/*
+		pz[i] = -px[i] mod p for i < n
+	*/
+	void gen_negVec()
+	{
+		StackFrame sf(this, 3, 2);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& pAddr = sf.t[1];
+		mov(pAddr, (size_t)p_);
+		gen_beginVec(sf.p[2]);
+		gen_raw_neg(pz, px, sf.t[0], pAddr);
+		gen_endVec(sf.p[2], pz, px, 0);
+	}
+	/*
+		pz[0..2n-1] = px[0..n-1] * py[0..n-1]
+	*/
+	void gen_mulPre()
+	{
+		const int n = pn_;
+		const int regNum = useMulx_ ? 4 : 3 + std::min(n - 1, 7);
+		const int spillN = (n - 1) - (regNum - 3);
+		StackFrame sf(this, 3, regNum | UseRDX, (n + spillN) * 8);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		const Reg64& y = sf.t[0];
+		const Reg64& t = sf.t[1];
+		const Reg64& c = sf.t[2];
+		Pack remain = sf.t.sub(3);
+		size_t rspPos = 0;
+
+		MixPack pw1(remain, rspPos, n - 1);
+		const RegExp pw2 = rsp + rspPos; // pw2[0..n-1]
+
+		if (n <= 9) {
+			gen_raw_mulPre(pz, px, py, y, t, pw1, pw2, n);
+			return;
+		}
+		mov(y, ptr [py]);
+		gen_raw_mulI(pz, px, y, pw1, t, n);
+		mov(ptr [pz + n * 8], rdx);
+		inLocalLabel();
+		mov(c, n - 1);
+	L(".lp");
+		add(py, 8);
+		add(pz, 8);
+		mov(y, ptr [py]);
+		gen_mulPreAdd(pz, px, y, pw1, pw2, t, n);
+		dec(c);
+		jnz(".lp", T_NEAR);
+		outLocalLabel();
+	}
+	/*
+		pz[0..2n-1] = px[0..n-1] * py[0..n-1] (unrolled)
+		use pw1, pw2[0..n-1], destroy y
+	*/
+	void gen_raw_mulPre(const RegExp& pz, const RegExp& px, const RegExp& py, const Reg64& y, const Reg64& t, const MixPack& pw1, const RegExp& pw2, int n)
+	{
+		mov(y, ptr [py]);
+		gen_raw_mulI(pz, px, y, pw1, t, n);
+		mov(ptr [pz + n * 8], rdx);
+		for (int i = 1; i < n; i++) {
+			mov(y, ptr [py + i * 8]);
+			gen_mulPreAdd(pz + i * 8, px, y, pw1, pw2, t, n);
+		}
+	}
+	/*
+		pz[0..n] = pz[0..n-1] + px[0..n-1] * y
+		use pw2[0..n-1]
+	*/
+	void gen_mulPreAdd(const RegExp& pz, const RegExp& px, const Reg64& y, const MixPack& pw1, const RegExp& pw2, const Reg64& t, int n)
+	{
+		gen_raw_mulI(pw2, px, y, pw1, t, n);
+		add_m_m(pz, pw2, t, n);
+		adc(rdx, 0);
+		mov(ptr [pz + n * 8], rdx);
+	}
+	/*
+		pz[0..n-1] = pxy[0..2n-1] / 2^(64n) mod p
+		assume pxy[] < p * 2^(64n)
+	*/
+	void gen_mod()
+	{
+		const int n = pn_;
+		const int regNum = useMulx_ ? 6 : 5 + std::min(n - 1, 5);
+		const int spillN = (n - 1) - (regNum - 5);
+		StackFrame sf(this, 2, regNum | UseRDX, (n * 3 + spillN) * 8);
+		const Reg64& pz = sf.p[0];
+		const Reg64& pxy = sf.p[1];
+		const Reg64& q = sf.t[0];
+		const Reg64& t = sf.t[1];
+		const Reg64& pAddr = sf.t[2];
+		const Reg64& cc = sf.t[3];
+		const Reg64& c = sf.t[4];
+		Pack remain = sf.t.sub(5);
+		size_t rspPos = 0;
+
+		MixPack pw1(remain, rspPos, n - 1);
+		const RegExp pw2 = rsp + rspPos; // pw2[0..n-1]
+		const RegExp pc = pw2 + n * 8; // pc[0..2n-1]
+
+		inLocalLabel();
+		mov(pAddr, (size_t)p_);
+		gen_mov(pc, pxy, t, n * 2);
+		xor_(cc, cc);
+		if (n <= 9) {
+			for (int i = 0; i < n; i++) {
+				gen_montRed1(pc + i * 8, q, pAddr, cc, t, pw1, pw2, n);
+			}
+		} else {
+			lea(pxy, ptr [pc]); // pxy is not used any more
+			mov(c, n);
+		L(".lp");
+			gen_montRed1(pxy, q, pAddr, cc, t, pw1, pw2, n);
+			add(pxy, 8);
+			dec(c);
+			jnz(".lp", T_NEAR);
+		}
+		// pz[] = [cc:pc[n..2n-1]] - p[]
+		gen_raw_sub(pz, pc + n * 8, pAddr, t);
+		sbb(cc, 0);
+		jnc(".exit", T_NEAR);
+		gen_mov(pz, pc + n * 8, t, n);
+	L(".exit");
+		outLocalLabel();
+	}
+	/*
+		q = pc[0] * pp
+		pc[1..n] += (q * p[] + pc[0]) >> 64 ; pc[n] += cc
+		cc = carry
+	*/
+	void gen_montRed1(const RegExp& pc, const Reg64& q, const Reg64& pAddr, const Reg64& cc, const Reg64& t, const MixPack& pw1, const RegExp& pw2, int n)
+	{
+		if (pp_ == 1) {
+			mov(q, ptr [pc]);
+		} else {
+			mov(rax, pp_);
+			mul(qword [pc]);
+			mov(q, rax);
+		}
+		gen_raw_mulI(pw2, pAddr, q, pw1, t, n);
+		mov(t, ptr [pc]);
+		add(t, ptr [pw2]); // t = 0
+		for (int i = 1; i < n; i++) {
+			mov(t, ptr [pc + i * 8]);
+			adc(t, ptr [pw2 + i * 8]);
+			mov(ptr [pc + i * 8], t);
+		}
+		adc(rdx, cc);
+		mov(cc, 0);
+		adc(cc, 0);
+		add(ptr [pc + n * 8], rdx);
+		adc(cc, 0);
+	}
+	/*
+		pz[0..2n-1] = px[] + py[] mod p * 2^(64n)
+	*/
+	void gen_addDbl()
+	{
+		const int n = pn_;
+		StackFrame sf(this, 3, 1, n * 8);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		const Reg64& pAddr = sf.t[0];
+		const RegExp pzH = pz + n * 8;
+
+		inLocalLabel();
+		gen_raw_add(pz, px, py, rax, n * 2);
+		mov(pAddr, (size_t)p_);
+		if (isFullBit_) jc(".over", T_NEAR);
+		gen_raw_sub(rsp, pzH, pAddr, rax);
+		jc(".exit", T_NEAR);
+		gen_mov(pzH, rsp, rax, n);
+		if (isFullBit_) {
+			jmp(".exit", T_NEAR);
+		L(".over");
+			gen_raw_sub(pzH, pzH, pAddr, rax);
+		}
+	L(".exit");
+		outLocalLabel();
+	}
+	/*
+		pz[0..2n-1] = px[] - py[] mod p * 2^(64n)
+	*/
+	void gen_subDbl()
+	{
+		const int n = pn_;
+		StackFrame sf(this, 3, 1);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		const Reg64& pAddr = sf.t[0];
+		const RegExp pzH = pz + n * 8;
+
+		inLocalLabel();
+		gen_raw_sub(pz, px, py, rax, n * 2);
+		jnc(".exit", T_NEAR);
+		mov(pAddr, (size_t)p_);
+		gen_raw_add(pzH, pzH, pAddr, rax);
+	L(".exit");
+		outLocalLabel();
+	}
+	/*
+		z[] = montgomery(x[], y[]) for ModPseudoMersenne or ModMersenne
+		isVec : mulVec_(pz, px, py, n)
+	*/
+	void gen_mulSpecial(bool isVec)
+	{
+		const int n = pn_;
+		assert(n <= 9);
+		const int regNum = useMulx_ ? 4 : 3 + std::min(n - 1, isVec ? 6 : 7);
+		StackFrame sf(this, isVec ? 4 : 3, regNum | UseRDX, (n * 4 - 1) * 8);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		const Reg64& y = sf.t[0];
+		const Reg64& t = sf.t[1];
+		const Reg64& c = sf.t[2];
+		Pack remain = sf.t.sub(3);
+		size_t rspPos = 0;
+
+		MixPack pw1(remain, rspPos, n - 1);
+		const RegExp pw2 = rsp + rspPos; // pw2[0..n-1]
+		const RegExp pxy = pw2 + n * 8; // pxy[0..2n-1]
+		if (isVec) gen_beginVec(sf.p[3]);
+		gen_raw_mulPre(pxy, px, py, y, t, pw1, pw2, n);
+		gen_specialRed(pz, pxy, y, t, c, pw2);
+		if (isVec) gen_endVec(sf.p[3], pz, px, &py);
+	}
+	/*
+		z[] = montgomery(x[], y[]) for ModPseudoMersenne and n <= 4 by adcx/adox
+		c[0..2n-1] = x * y is held in registers and c[i] is reduced as soon as it is fixed
+		isVec : mulVec_(pz, px, py, n)
+	*/
+	void gen_mulPseudoMersenneAdx(int n, bool isVec)
+	{
+		assert(modType_ == ModPseudoMersenne && useAdx_ && n <= 4);
+		// the count of mulVec_ is kept in [rsp] and p3 is used as a temporary
+		StackFrame sf(this, isVec ? 4 : 3, (isVec ? 9 : 10) | UseRDX, isVec ? 8 : 0);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		// pz and py are kept in xm0 and xm1 and their registers are used for c[]
+		Pack t = sf.t;
+		if (isVec) t.append(sf.p[3]);
+		t.append(pz).append(py);
+		const Reg64& h = t[0];
+		const Reg64& cr = t[1];
+		const Reg64& pp = t[2];
+		const Reg64& hq = t[3];
+		Pack c = t.sub(4, n * 2);
+
+		if (isVec) {
+			mov(ptr [rsp], sf.p[3]);
+			gen_beginVec(sf.p[3]);
+		}
+		movq(xm0, pz);
+		movq(xm1, py);
+		mov(cr, pmC_);
+		mov(pp, pp_);
+		for (int i = 0; i < n; i++) {
+			movq(h, xm1);
+			mov(rdx, ptr [h + i * 8]);
+			if (i == 0) {
+				mulPack(c.sub(0, n), px, rdx);
+				mov(c[n], rdx);
+			} else {
+				// c[i..i+n] += x[] * y[i]
+				xor_(c[i + n], c[i + n]); // clear CF and OF
+				for (int j = 0; j < n; j++) {
+					mulx(h, rax, ptr [px + j * 8]);
+					adox(c[i + j], rax);
+					adcx(c[i + j + 1], h);
+				}
+				mov(eax, 0); // keep flags
+				adox(c[i + n], rax);
+			}
+			/*
+				-1/p = 1/c mod 2^64 and q c = u mod 2^64 for u = c[i] - hq
+				c[i] is replaced with q and hq = ((q c - u) >> 64) + borrow
+			*/
+			mov(rdx, c[i]);
+			if (i > 0) {
+				sub(rdx, hq);
+				sbb(c[i], c[i]);
+			}
+			imul(rdx, pp);
+			mulx(hq, rax, cr);
+			if (i > 0) sub(hq, c[i]);
+			mov(c[i], rdx);
+		}
+		// [pp:c[n..2n-1]] = c[n..2n-1] + q[] - hq < 2p
+		xor_(pp, pp);
+		add_rr(c.sub(n, n), c.sub(0, n));
+		adc(pp, 0);
+		sub(c[n], hq);
+		for (int i = 1; i < n; i++) {
+			sbb(c[n + i], 0);
+		}
+		sbb(pp, 0);
+		// c[0..n-1] = c[n..2n-1] - p = c[n..2n-1] + c - 2^(64n) and pp = 1 if it is >= p
+		for (int i = 0; i < n; i++) {
+			mov(c[i], c[n + i]);
+		}
+		add(c[0], cr);
+		for (int i = 1; i < n; i++) {
+			adc(c[i], 0);
+		}
+		adc(pp, 0);
+		for (int i = 0; i < n; i++) {
+			cmovnz(c[n + i], c[i]);
+		}
+		movq(h, xm0);
+		store_mr(h, c.sub(n, n));
+		if (isVec) {
+			movq(pz, xm0);
+			movq(py, xm1);
+			gen_endVec(qword [rsp], pz, px, &py);
+		}
+	}
+	/*
+		mod_ for ModPseudoMersenne or ModMersenne
+		pz[] = pxy[0..2n-1] / R mod p
+	*/
+	void gen_modSpecial()
+	{
+		StackFrame sf(this, 2, 3 | UseRDX, pn_ * 8);
+		gen_specialRed(sf.p[0], sf.p[1], sf.t[0], sf.t[1], sf.t[2], rsp);
+	}
+	/*
+		pz[] = pxy[0..2n-1] / R mod p for pxy[] < pR
+		use pw[0..n-1], destroy t0, t1, t2
+	*/
+	void gen_specialRed(const RegExp& pz, const RegExp& pxy, const Reg64& t0, const Reg64& t1, const Reg64& t2, const RegExp& pw)
+	{
+		if (modType_ == ModPseudoMersenne) {
+			gen_pseudoMersenneRed(pz, pxy, t0, t1, t2, pw);
+		} else {
+			gen_mersenneRed(pz, pxy, t0, t1, t2, pw);
+		}
+	}
+	/*
+		p = 2^(64n) - c and -1/p = 1/c mod 2^64
+		for i < n ; q[i] = (x[i] - h) / c mod 2^64, h = ((q[i] c - x[i] + h) >> 64) + borrow
+		then x / R = x[n..2n-1] + q[] - h < 2p
+		use pw[0..n-1], destroy cr, t, h
+	*/
+	void gen_pseudoMersenneRed(const RegExp& pz, const RegExp& pxy, const Reg64& cr, const Reg64& t, const Reg64& h, const RegExp& pw)
+	{
+		const int n = pn_;
+		inLocalLabel();
+		mov(cr, pmC_);
+		for (int i = 0; i < n; i++) {
+			mov(rax, ptr [pxy + i * 8]);
+			if (i > 0) {
+				sub(rax, h);
+				sbb(t, t);
+			}
+			mov(rdx, pp_);
+			imul(rax, rdx);
+			mov(ptr [pw + i * 8], rax);
+			mul(cr);
+			if (i > 0) sub(rdx, t);
+			mov(h, rdx);
+		}
+		// [t:pw] = x[n..2n-1] + q[] - h
+		for (int i = 0; i < n; i++) {
+			mov(rax, ptr [pxy + (n + i) * 8]);
+			if (i == 0) {
+				add(rax, ptr [pw + i * 8]);
+			} else {
+				adc(rax, ptr [pw + i * 8]);
+			}
+			mov(ptr [pw + i * 8], rax);
+		}
+		mov(t, 0);
+		adc(t, 0);
+		sub(ptr [pw], h);
+		for (int i = 1; i < n; i++) {
+			sbb(qword [pw + i * 8], 0);
+		}
+		sbb(t, 0);
+		// pz[] = pw[] - p = pw[] + c - 2^(64n) if [t:pw] >= p
+		mov(rax, ptr [pw]);
+		add(rax, cr);
+		mov(ptr [pz], rax);
+		for (int i = 1; i < n; i++) {
+			mov(rax, ptr [pw + i * 8]);
+			adc(rax, 0);
+			mov(ptr [pz + i * 8], rax);
+		}
+		adc(t, 0);
+		jnz(".exit", T_NEAR);
+		gen_mov(pz, pw, rax, n);
 	L(".exit");
 		outLocalLabel();
 	}
-	void gen_neg()
-	{
-		StackFrame sf(this, 2, 2);
-		const Reg64& pz = sf.p[0];
-		const Reg64& px = sf.p[1];
-		gen_raw_neg(pz, px, sf.t[0], sf.t[1]);
-	}
-	void gen_shr1()
+	/*
+		p = 2^k - 1 ; k = 64(n - 1) + s
+		x = H 2^k + L = H + L mod p
+		and x / R = x 2^-d mod p for R = 2^(k + d), d = 64 - s, is a rotation of k bits
+		use pw[0..n-1], destroy t0, t1, t2
+	*/
+	void gen_mersenneRed(const RegExp& pz, const RegExp& pxy, const Reg64& t0, const Reg64& t1, const Reg64& t2, const RegExp& pw)
 	{
-		const int c = 1;
-		StackFrame sf(this, 2, 1);
-		const Reg64 *t0 = &rax;
-		const Reg64 *t1 = &sf.t[0];
-		const Reg64& pz = sf.p[0];
-		const Reg64& px = sf.p[1];
-		mov(*t0, ptr [px]);
-		for (int i = 0; i < pn_ - 1; i++) {
-			mov(*t1, ptr [px + 8 * (i + 1)]);
-			shrd(*t0, *t1, c);
-			mov(ptr [pz + i * 8], *t0);
-			std::swap(t0, t1);
+		const int n = pn_;
+		const int s = msBit_;
+		assert(0 < s && s < 64);
+		inLocalLabel();
+		// pw[] = H = pxy[] >> k
+		for (int i = 0; i < n; i++) {
+			mov(t0, ptr [pxy + (n - 1 + i) * 8]);
+			mov(t1, ptr [pxy + (n + i) * 8]);
+			shrd(t0, t1, s);
+			mov(ptr [pw + i * 8], t0);
+		}
+		// [t1:t2:pw[0..n-2]] = H + L
+		mov(t2, ptr [pxy + (n - 1) * 8]);
+		shl(t2, 64 - s); // L is masked with 2^k - 1
+		shr(t2, 64 - s);
+		for (int i = 0; i < n - 1; i++) {
+			mov(t0, ptr [pxy + i * 8]);
+			if (i == 0) {
+				add(t0, ptr [pw + i * 8]);
+			} else {
+				adc(t0, ptr [pw + i * 8]);
+			}
+			mov(ptr [pw + i * 8], t0);
+		}
+		adc(t2, ptr [pw + (n - 1) * 8]);
+		mov(t1, 0);
+		adc(t1, 0);
+		// fold the bits over k again ; pw[] < 2p then
+		mov(t0, t2);
+		shrd(t0, t1, s);
+		shl(t2, 64 - s);
+		shr(t2, 64 - s);
+		mov(ptr [pw + (n - 1) * 8], t2);
+		add(ptr [pw], t0);
+		for (int i = 1; i < n; i++) {
+			adc(qword [pw + i * 8], 0);
 		}
-		shr(*t0, c);
-		mov(ptr [pz + (pn_ - 1) * 8], *t0);
-	}
-	void gen_mul()
-	{
-		if (pn_ == 3) {
-			gen_montMul3(p_, pp_);
-		} else if (pn_ == 4) {
-			gen_montMul4(p_, pp_);
-		} else if (pn_ <= 9) {
-			gen_montMulN(p_, pp_, pn_);
-		} else {
-			throw cybozu::Exception("mie:FpGenerator:gen_mul:not implemented for") << pn_;
+		// pz[] = pw[] - p = pw[] + 1 - 2^k if pw[] >= p
+		mov(t0, ptr [pw]);
+		add(t0, 1);
+		mov(ptr [pz], t0);
+		for (int i = 1; i < n; i++) {
+			mov(t0, ptr [pw + i * 8]);
+			adc(t0, 0);
+			if (i == n - 1) btr(t0, s);
+			mov(ptr [pz + i * 8], t0);
+		}
+		jc(".exit", T_NEAR);
+		gen_mov(pz, pw, t0, n);
+	L(".exit");
+		outLocalLabel();
+		// pz[] = (pz[] >> d) | ((pz[] mod 2^d) << (k - d)) ; the rotation of x < p is less than p
+		const int d = 64 - s;
+		const int q = (64 * (n - 1) + s - d) / 64;
+		const int r = (64 * (n - 1) + s - d) % 64;
+		mov(t2, ptr [pz]);
+		for (int i = 0; i < n - 1; i++) {
+			mov(t0, ptr [pz + i * 8]);
+			mov(t1, ptr [pz + (i + 1) * 8]);
+			shrd(t0, t1, d);
+			mov(ptr [pz + i * 8], t0);
+		}
+		shr(qword [pz + (n - 1) * 8], d);
+		shl(t2, s);
+		shr(t2, s);
+		mov(t0, t2);
+		shl(t0, r);
+		or_(ptr [pz + q * 8], t0);
+		if (r > 0 && q + 1 < n) {
+			shr(t2, 64 - r);
+			or_(ptr [pz + (q + 1) * 8], t2);
 		}
 	}
 	/*
 		input (pz[], px[], py[])
 		z[] <- montgomery(x[], y[])
 	*/
-	void gen_montMulN(const uint64_t *p, uint64_t pp, int n)
+	void gen_montMulN(const uint64_t *p, uint64_t pp, int n, bool isVec)
 	{
 		assert(2 <= pn_ && pn_ <= 9);
-		const int regNum = useMulx_ ? 4 : 3 + std::min(n - 1, 7);
+		const int regNum = useMulx_ ? 4 : 3 + std::min(n - 1, isVec ? 6 : 7);
 		const int stackSize = (n * 3 + (isFullBit_ ? 2 : 1)) * 8;
-		StackFrame sf(this, 3, regNum | UseRDX, stackSize);
+		StackFrame sf(this, isVec ? 4 : 3, regNum | UseRDX, stackSize);
 		const Reg64& pz = sf.p[0];
 		const Reg64& px = sf.p[1];
 		const Reg64& py = sf.p[2];
@@ -590,6 +1584,7 @@ struct FpGenerator : Xbyak::CodeGenerator {
 		const RegExp pw2 = rsp + rspPos; // pw2[0..n-1]
 		const RegExp pc = pw2 + n * 8; // pc[0..n+1]
 		mov(pAddr, (size_t)p);
+		if (isVec) gen_beginVec(sf.p[3]);
 
 		for (int i = 0; i < n; i++) {
 			mov(y, ptr [py + i * 8]);
@@ -604,15 +1599,161 @@ struct FpGenerator : Xbyak::CodeGenerator {
 			mov(ptr [pz + i * 8], t);
 		}
 	L("@@");
+		if (isVec) gen_endVec(sf.p[3], pz, px, &py);
+	}
+	/*
+		input (pz[], px[], py[])
+		z[] <- montgomery(x[], y[])
+		same as gen_montMulN but the loop over y[i] is not unrolled
+		so that the code size is O(n) for a large n
+	*/
+	void gen_montMulLoop(const uint64_t *p, uint64_t pp, int n, bool isVec)
+	{
+		const int regNum = useMulx_ ? 5 : (isVec ? 9 : 10);
+		const int stackSize = (n * 3 + 1) * 8;
+		StackFrame sf(this, isVec ? 4 : 3, regNum | UseRDX, stackSize);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		const Reg64& y = sf.t[0];
+		const Reg64& pAddr = sf.t[1];
+		const Reg64& t = sf.t[2];
+		const Reg64& c = sf.t[3];
+		Pack remain = sf.t.sub(4);
+		size_t rspPos = 0;
+
+		MixPack pw1(remain, rspPos, n - 1);
+		const RegExp pw2 = rsp + rspPos; // pw2[0..n-1]
+		const RegExp pc = pw2 + n * 8; // pc[0..n+1]
+
+		mov(pAddr, (size_t)p);
+		if (isVec) gen_beginVec(sf.p[3]);
+		inLocalLabel();
+		// pc[0..n] = 0
+		xor_(eax, eax);
+		for (int i = 0; i <= n; i++) {
+			mov(ptr [pc + i * 8], rax);
+		}
+		mov(c, n);
+	L(".lp");
+		mov(y, ptr [py]);
+		montgomeryN_1(pp, n, pc, px, y, pAddr, t, pw1, pw2, false);
+		add(py, 8);
+		dec(c);
+		jnz(".lp", T_NEAR);
+		// pz[] = pc[] - p[]
+		gen_raw_sub(pz, pc, pAddr, t);
+		if (isFullBit_) sbb(qword[pc + n * 8], 0);
+		jnc(".exit", T_NEAR);
+		gen_mov(pz, pc, t, n);
+	L(".exit");
+		outLocalLabel();
+		// py has been advanced by pn_ limbs
+		if (isVec) {
+			if (elemN_ > pn_) add(py, (elemN_ - pn_) * 8);
+			gen_endVec(sf.p[3], pz, px, 0);
+		}
+	}
+	/*
+		input (pz[], px[], py[])
+		z[] <- montgomery(x[], y[]) by CIOS with c[] in registers
+		each row c[] += a[] * d is made of two carry chains
+		adox for the low halves and adcx for the high halves of a[j] * d
+		c[0..n] (c[0..n+1] if isFullBit_) ; n <= 9 (n <= 8 if isFullBit_)
+		destroy xm0, xm1
+	*/
+	void gen_montMulAdx(int n, bool isVec)
+	{
+		assert(useAdx_ && n <= (isFullBit_ ? 8 : 9));
+		// the count of mulVec_ is kept in [rsp] and p3 is used as a temporary
+		StackFrame sf(this, isVec ? 4 : 3, (isVec ? 9 : 10) | UseRDX, isVec ? 8 : 0);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		// pz and py are kept in xm0 and xm1 and their registers are used for c[]
+		Pack t = sf.t;
+		if (isVec) t.append(sf.p[3]);
+		t.append(pz).append(py);
+		const Reg64& pAddr = t[0];
+		const Reg64& h = t[1];
+		Pack c = t.sub(2, n + (isFullBit_ ? 2 : 1));
+
+		if (isVec) {
+			mov(ptr [rsp], sf.p[3]);
+			gen_beginVec(sf.p[3]);
+		}
+		movq(xm0, pz);
+		movq(xm1, py);
+		mov(pAddr, (size_t)p_);
+		for (int i = 0; i < n; i++) {
+			movq(h, xm1);
+			mov(rdx, ptr [h + i * 8]);
+			if (i == 0) {
+				if (isFullBit_) xor_(c[n + 1], c[n + 1]);
+				mulPack(c.sub(0, n), px, rdx);
+				mov(c[n], rdx);
+			} else {
+				mulAddAdx(c, px, h, n);
+			}
+			// q = c[0] * pp, c = (c + q * p) >> 64
+			if (pp_ == 1) {
+				mov(rdx, c[0]);
+			} else {
+				mov(rdx, pp_);
+				imul(rdx, c[0]);
+			}
+			mulAddAdx(c, pAddr, h, n);
+			// c[0] is zero and becomes the top
+			Pack r = c.sub(1);
+			r.append(c[0]);
+			c = r;
+		}
+		// z = c - p if c >= p
+		movq(h, xm0);
+		store_mr(h, c.sub(0, n));
+		sub_rm(c.sub(0, n), pAddr);
+		if (isFullBit_) sbb(c[n], 0);
+		for (int i = 0; i < n; i++) {
+			cmovc(c[i], ptr [h + i * 8]);
+		}
+		store_mr(h, c.sub(0, n));
+		if (isVec) {
+			movq(pz, xm0);
+			movq(py, xm1);
+			gen_endVec(qword [rsp], pz, px, &py);
+		}
+	}
+	/*
+		c[] += pa[0..n-1] * rdx
+		the low half of pa[j] * rdx is added to c[j] by adox (OF)
+		and the high half to c[j + 1] by adcx (CF)
+		c has n + 1 limbs (n + 2 if isFullBit_) and the result must fit in it
+		destroy rax, h
+	*/
+	void mulAddAdx(const Pack& c, const RegExp& pa, const Reg64& h, int n)
+	{
+		xor_(eax, eax); // clear CF and OF
+		for (int j = 0; j < n; j++) {
+			mulx(h, rax, ptr [pa + j * 8]);
+			adox(c[j], rax);
+			adcx(c[j + 1], h);
+		}
+		mov(eax, 0); // keep flags
+		adox(c[n], rax);
+		if (isFullBit_) {
+			adcx(c[n + 1], rax);
+			adox(c[n + 1], rax);
+		}
 	}
 	/*
 		input (z, x, y) = (p0, p1, p2)
 		z[0..3] <- montgomery(x[0..3], y[0..3])
 		destroy gt0, ..., gt9, xm0, xm1, p2
 	*/
-	void gen_montMul4(const uint64_t *p, uint64_t pp)
+	void gen_montMul4(const uint64_t *p, uint64_t pp, bool isVec)
 	{
-		StackFrame sf(this, 3, 10 | UseRDX);
+		// the count of mulVec_ is kept in [rsp] and p3 is used as t9
+		StackFrame sf(this, isVec ? 4 : 3, (isVec ? 9 : 10) | UseRDX, isVec ? 8 : 0);
 		const Reg64& p0 = sf.p[0];
 		const Reg64& p1 = sf.p[1];
 		const Reg64& p2 = sf.p[2];
@@ -626,8 +1767,12 @@ struct FpGenerator : Xbyak::CodeGenerator {
 		const Reg64& t6 = sf.t[6];
 		const Reg64& t7 = sf.t[7];
 		const Reg64& t8 = sf.t[8];
-		const Reg64& t9 = sf.t[9];
+		const Reg64& t9 = isVec ? sf.p[3] : sf.t[9];
 
+		if (isVec) {
+			mov(ptr [rsp], sf.p[3]);
+			gen_beginVec(sf.p[3]);
+		}
 		movq(xm0, p0); // save p0
 		mov(p0, (uint64_t)p);
 		movq(xm1, p2);
@@ -660,15 +1805,20 @@ struct FpGenerator : Xbyak::CodeGenerator {
 
 		movq(p0, xm0); // load p0
 		store_mr(p0, Pack(t3, t2, t1, t0));
+		if (isVec) {
+			movq(p2, xm1);
+			gen_endVec(qword [rsp], p0, p1, &p2);
+		}
 	}
 	/*
 		input (z, x, y) = (p0, p1, p2)
 		z[0..2] <- montgomery(x[0..2], y[0..2])
 		destroy gt0, ..., gt9, xm0, xm1, p2
 	*/
-	void gen_montMul3(const uint64_t *p, uint64_t pp)
+	void gen_montMul3(const uint64_t *p, uint64_t pp, bool isVec)
 	{
-		StackFrame sf(this, 3, 10 | UseRDX);
+		// the count of mulVec_ is kept in [rsp] and p3 is used as t9
+		StackFrame sf(this, isVec ? 4 : 3, (isVec ? 9 : 10) | UseRDX, isVec ? 8 : 0);
 		const Reg64& p0 = sf.p[0];
 		const Reg64& p1 = sf.p[1];
 		const Reg64& p2 = sf.p[2];
@@ -682,8 +1832,12 @@ struct FpGenerator : Xbyak::CodeGenerator {
 		const Reg64& t6 = sf.t[6];
 		const Reg64& t7 = sf.t[7];
 		const Reg64& t8 = sf.t[8];
-		const Reg64& t9 = sf.t[9];
+		const Reg64& t9 = isVec ? sf.p[3] : sf.t[9];
 
+		if (isVec) {
+			mov(ptr [rsp], sf.p[3]);
+			gen_beginVec(sf.p[3]);
+		}
 		movq(xm0, p0); // save p0
 		mov(t7, (uint64_t)p);
 		mov(t9, ptr [p2]);
@@ -706,6 +1860,470 @@ struct FpGenerator : Xbyak::CodeGenerator {
 		cmovc(t2, t6);
 		movq(p0, xm0);
 		store_mr(p0, Pack(t2, t1, t0));
+		if (isVec) gen_endVec(qword [rsp], p0, p1, &p2);
+	}
+	void gen_sqr()
+	{
+		if (useSpecialMul() || pn_ > 9) {
+			// z = x * x by mul_
+			StackFrame sf(this, 3, 0, 0, false);
+			mov(sf.p[2], sf.p[1]);
+			jmp((const void*)mul_, T_NEAR);
+		} else if (pn_ <= 4) {
+			gen_montSqr_le4(pn_);
+		} else {
+			gen_montSqrN(pn_);
+		}
+	}
+	/*
+		input (pz[], px[])
+		z[] <- montgomery(x[], x[])
+		c[0..2n-1] = x^2 is made of n(n-1)/2 products x[i] * x[j] (i < j) doubled
+		and n squares x[i]^2, then c is reduced as
+		(c[0..n-1] + q * p) / R + c[n..2n-1]
+		all of c[] is held in registers
+	*/
+	void gen_montSqr_le4(int n)
+	{
+		assert(2 <= n && n <= 4);
+		StackFrame sf(this, 2, (n * 2 + 2) | UseRDX, n * 8);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Pack c = sf.t.sub(0, n * 2);
+		const Reg64& t0 = sf.t[n * 2];
+		const Reg64& t1 = sf.t[n * 2 + 1];
+
+		movq(xm0, pz); // save pz
+		// c[1..n] = x[0] * x[1..n-1]
+		if (useMulx_) mov(rdx, ptr [px]);
+		mulPack(c.sub(1, n - 1), px + 8, qword [px]);
+		mov(c[n], rdx);
+		// c[2i+1..i+n] += x[i] * x[i+1..n-1]
+		for (int i = 1; i < n - 1; i++) {
+			const int k = n - 1 - i;
+			const Pack w = Pack(t1, t0).sub(0, k);
+			if (useMulx_) mov(rdx, ptr [px + i * 8]);
+			mulPack(w, px + (i + 1) * 8, qword [px + i * 8]);
+			add_rr(c.sub(i * 2 + 1, k), w);
+			adc(rdx, 0);
+			mov(c[i + n], rdx);
+		}
+		// c[1..2n-1] *= 2
+		xor_(c[n * 2 - 1], c[n * 2 - 1]);
+		add_rr(c.sub(1, n * 2 - 1), c.sub(1, n * 2 - 1));
+		// c[] += x[i]^2
+		if (useMulx_) {
+			mov(rdx, ptr [px]);
+			mulx(t0, c[0], rdx);
+			add(c[1], t0);
+			for (int i = 1; i < n; i++) {
+				mov(rdx, ptr [px + i * 8]);
+				mulx(t1, t0, rdx);
+				adc(c[i * 2], t0);
+				adc(c[i * 2 + 1], t1);
+			}
+		} else {
+			// t0 keeps the upper half of x[i-1]^2 with the carry
+			mov(rax, ptr [px]);
+			mul(rax);
+			mov(c[0], rax);
+			mov(t0, rdx);
+			for (int i = 1; i < n; i++) {
+				mov(rax, ptr [px + i * 8]);
+				mul(rax);
+				add(c[i * 2 - 1], t0);
+				adc(c[i * 2], rax);
+				adc(rdx, 0);
+				mov(t0, rdx);
+			}
+			add(c[n * 2 - 1], t0);
+		}
+		store_mr(rsp, c.sub(n, n)); // keep upper half
+		/*
+			reduce c[0..n-1]
+			window = [top:c[n-1]:...:c[0]]
+			top is always zero unless isFullBit_
+		*/
+		const Reg64& pAddr = pz;
+		const Reg64& q = t1;
+		const Pack w = c.sub(n, n);
+		Pack window = c.sub(0, n);
+		window.append(t0);
+		mov(pAddr, (size_t)p_);
+		xor_(t0, t0);
+		for (int i = 0; i < n; i++) {
+			if (useMulx_) {
+				mov(rdx, pp_);
+				imul(rdx, window[0]);
+			} else {
+				mov(q, pp_);
+				imul(q, window[0]);
+			}
+			mulPack(w, pAddr, q);
+			add_rr(window.sub(0, n), w);
+			adc(window[n], rdx);
+			if (isFullBit_) adc(window[0], 0); // window[0] is zero
+			// rotate window
+			Pack next = window.sub(1, n);
+			next.append(window[0]);
+			window = next;
+		}
+		// window += upper half
+		add_rm(window.sub(0, n), rsp);
+		if (isFullBit_) adc(window[n], 0);
+		// w = window - p if window >= p
+		mov_rr(w, window.sub(0, n));
+		sub_rm(w, pAddr);
+		if (isFullBit_) sbb(window[n], 0);
+		for (int i = 0; i < n; i++) {
+			cmovc(w[i], window[i]);
+		}
+		movq(pz, xm0);
+		store_mr(pz, w);
+	}
+	/*
+		input (pz[], px[])
+		z[] <- montgomery(x[], x[])
+		same as gen_montSqr_le4 but c[] is on the stack
+	*/
+	void gen_montSqrN(int n)
+	{
+		assert(5 <= n && n <= 9);
+		const int regNum = useMulx_ ? 4 : 3 + std::min(n - 1, 7);
+		const int stackSize = n * 6 * 8;
+		StackFrame sf(this, 2, regNum | UseRDX, stackSize);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& y = sf.t[0];
+		const Reg64& pAddr = sf.t[1];
+		const Reg64& t = sf.t[2];
+		Pack remain = sf.t.sub(3);
+		size_t rspPos = 0;
+
+		MixPack wk(remain, rspPos, n - 1);
+		const RegExp pc = rsp + rspPos; // pc[0..2n-1]
+		const RegExp pd = pc + n * 2 * 8; // pd[0..2n-1]
+		const RegExp pw = pd + n * 2 * 8; // pw[0..n-1]
+		const RegExp pr = pd; // pr[0..n] ; reuse pd
+
+		// pc[1..n] = x[0] * x[1..n-1]
+		mov(y, ptr [px]);
+		gen_raw_mulI(pc + 8, px + 8, y, wk, t, n - 1);
+		mov(ptr [pc + n * 8], rdx);
+		// pc[2i+1..i+n] += x[i] * x[i+1..n-1]
+		for (int i = 1; i < n - 1; i++) {
+			const int k = n - 1 - i;
+			mov(y, ptr [px + i * 8]);
+			if (k == 1) {
+				mov(rax, ptr [px + (n - 1) * 8]);
+				mul(y);
+				mov(ptr [pw], rax);
+			} else {
+				gen_raw_mulI(pw, px + (i + 1) * 8, y, wk, t, k);
+			}
+			add_m_m(pc + (i * 2 + 1) * 8, pw, t, k);
+			adc(rdx, 0);
+			mov(ptr [pc + (i + n) * 8], rdx);
+		}
+		// pd[2i..2i+1] = x[i]^2
+		for (int i = 0; i < n; i++) {
+			mov(rax, ptr [px + i * 8]);
+			mul(rax);
+			mov(ptr [pd + i * 16], rax);
+			mov(ptr [pd + i * 16 + 8], rdx);
+		}
+		// pc[1..2n-1] *= 2
+		mov(t, ptr [pc + 8]);
+		add(t, t);
+		mov(ptr [pc + 8], t);
+		for (int i = 2; i < n * 2 - 1; i++) {
+			mov(t, ptr [pc + i * 8]);
+			adc(t, t);
+			mov(ptr [pc + i * 8], t);
+		}
+		mov(t, 0);
+		adc(t, 0);
+		mov(ptr [pc + (n * 2 - 1) * 8], t);
+		// pc[] += pd[] ; pc[0] is not set yet
+		mov(t, ptr [pd]);
+		mov(ptr [pc], t);
+		add_m_m(pc + 8, pd + 8, t, n * 2 - 1);
+		/*
+			pr[] = (pc[0..n-1] + q * p) / R
+			pr[n] is used if isFullBit_
+		*/
+		mov(pAddr, (size_t)p_);
+		mov(y, pp_);
+		imul(y, ptr [pc]); // y = q
+		for (int i = 0; i < n; i++) {
+			const RegExp& src = i == 0 ? pc : pr;
+			gen_raw_mulI(pw, pAddr, y, wk, t, n);
+			mov(t, ptr [pw]);
+			add(t, ptr [src]);
+			for (int j = 1; j < n; j++) {
+				mov(t, ptr [pw + j * 8]);
+				adc(t, ptr [src + j * 8]);
+				mov(ptr [pr + (j - 1) * 8], t);
+				if (j == 1) mov(y, t); // keep pr[0] for the next q
+			}
+			if (isFullBit_ && i > 0) {
+				adc(rdx, ptr [pr + n * 8]);
+			} else {
+				adc(rdx, 0);
+			}
+			mov(ptr [pr + (n - 1) * 8], rdx);
+			if (isFullBit_) {
+				mov(t, 0);
+				adc(t, 0);
+				mov(ptr [pr + n * 8], t);
+			}
+			if (i < n - 1) {
+				mov(rax, pp_);
+				imul(y, rax);
+			}
+		}
+		// pr[] += pc[n..2n-1]
+		add_m_m(pr, pc + n * 8, t, n);
+		if (isFullBit_) adc(qword [pr + n * 8], 0);
+		// pz[] = pr[] - p[]
+		gen_raw_sub(pz, pr, pAddr, t);
+		if (isFullBit_) sbb(qword [pr + n * 8], 0);
+		jnc("@f");
+		for (int i = 0; i < n; i++) {
+			mov(t, ptr [pr + i * 8]);
+			mov(ptr [pz + i * 8], t);
+		}
+	L("@@");
+	}
+	/*
+		bits [pos, pos + len) of x[0..n) (bits out of range are zero)
+	*/
+	static uint64_t getBits(const uint64_t *x, int n, int pos, int len)
+	{
+		uint64_t r = 0;
+		for (int i = 0; i < len; i++) {
+			const int b = pos + i;
+			if (b < 0 || b >= n * 64) continue;
+			if ((x[b / 64] >> (b % 64)) & 1) r |= uint64_t(1) << i;
+		}
+		return r;
+	}
+	/*
+		each value of simdTbl_ is repeated laneN times
+		[0, dn) : w-bit digits of p
+		[dn, dn + rn) : w-bit digits of p << w2 (the top digit keeps the rest)
+		dn + rn : -1/p mod 2^w
+		dn + rn + 1 : 2^w - 1
+		dn + rn + 2 : 2^w2 - 1
+	*/
+	void setSimdTbl(int w, int dn, int w2, int rn, int laneN)
+	{
+		const int n = pn_;
+		if ((size_t)(dn + rn + 3) * laneN > simdTblN) throw cybozu::Exception("mie:FpGenerator:setSimdTbl:too large") << dn << rn;
+		const uint64_t mask = (uint64_t(1) << w) - 1;
+		uint64_t v[64];
+		for (int i = 0; i < dn; i++) {
+			v[i] = getBits(p_, n, w * i, w);
+		}
+		for (int i = 0; i < rn; i++) {
+			v[dn + i] = getBits(p_, n, w * i - w2, i == rn - 1 ? 64 : w);
+		}
+		v[dn + rn] = pp_ & mask;
+		v[dn + rn + 1] = mask;
+		v[dn + rn + 2] = (uint64_t(1) << w2) - 1;
+		for (int i = 0; i < dn + rn + 3; i++) {
+			for (int j = 0; j < laneN; j++) {
+				simdTbl_[i * laneN + j] = v[i];
+			}
+		}
+	}
+	/*
+		zmm16..31 need no saving on Win64 and leave xmm0..3 for gather and scatter
+	*/
+	static Xbyak::Zmm vreg(int idx) { return Xbyak::Zmm(16 + idx); }
+	/*
+		lane e of vreg(k) = ptr [px + e * elemN_ * 8] (e < 8)
+		destroy xmm0..3
+	*/
+	void gen_simdGather(int k, const RegExp& px)
+	{
+		const int s = elemN_ * 8;
+		for (int h = 0; h < 2; h++) {
+			const int x = h * 2;
+			const int y = h * 2 + 1;
+			const RegExp p = px + s * 4 * h;
+			vmovq(Xmm(x), ptr [p]);
+			vpinsrq(Xmm(x), Xmm(x), ptr [p + s], 1);
+			vmovq(Xmm(y), ptr [p + s * 2]);
+			vpinsrq(Xmm(y), Xmm(y), ptr [p + s * 3], 1);
+			vinserti128(Xbyak::Ymm(x), Xbyak::Ymm(x), Xmm(y), 1);
+		}
+		vinserti64x4(vreg(k), Xbyak::Zmm(0), Xbyak::Ymm(2), 1);
+	}
+	/*
+		ptr [pz + e * elemN_ * 8] = lane e of vreg(k)
+		destroy xmm0..1
+	*/
+	void gen_simdScatter(const RegExp& pz, int k)
+	{
+		const int s = elemN_ * 8;
+		for (int h = 0; h < 2; h++) {
+			const RegExp p = pz + s * 4 * h;
+			vextracti64x4(Xbyak::Ymm(1), vreg(k), h);
+			vmovq(ptr [p], Xmm(1));
+			vpextrq(ptr [p + s], Xmm(1), 1);
+			vextracti128(Xmm(0), Xbyak::Ymm(1), 1);
+			vmovq(ptr [p + s * 2], Xmm(0));
+			vpextrq(ptr [p + s * 3], Xmm(0), 1);
+		}
+	}
+	/*
+		pd[j] = j-th w-bit digits of each lane of px (j < dn)
+		use vreg(0..pn_ + 1)
+	*/
+	void gen_simdLoad(const RegExp& pd, const RegExp& px, int w, int dn, const Xbyak::Address& mask)
+	{
+		const int n = pn_;
+		for (int k = 0; k < n; k++) {
+			gen_simdGather(k, px + k * 8);
+		}
+		const Xbyak::Zmm d = vreg(n);
+		const Xbyak::Zmm t = vreg(n + 1);
+		for (int j = 0; j < dn; j++) {
+			const int a = (w * j) / 64;
+			const int b = (w * j) % 64;
+			if (b == 0) {
+				vpandq(d, vreg(a), mask);
+			} else {
+				vpsrlq(d, vreg(a), b);
+				if (b + w > 64 && a + 1 < n) {
+					vpsllq(t, vreg(a + 1), 64 - b);
+					vporq(d, d, t);
+				}
+				vpandq(d, d, mask);
+			}
+			vmovdqu64(ptr [pd + j * 64], d);
+		}
+	}
+	/*
+		z[i] = montgomery(x[i], y[i]) for i < n (n is a multiple of 8)
+		each of 8 lanes holds one element as dn digits of w = 52 bits
+		for vpmadd52[lh]uq (AVX-512 IFMA)
+		the last reduction step removes only w2 = 64 * pn_ - w * (dn - 1) bits,
+		so the result is x * y / 2^(64 * pn_) mod p as mul_
+	*/
+	void gen_mulSimd()
+	{
+		const int n = pn_;
+		const int w = 52;
+		const int vn = 64;
+		const int laneN = 8;
+		const int dn = (n * 64 + w - 1) / w;
+		const int w2 = n * 64 - w * (dn - 1);
+		const int rn = dn + 1;
+		setSimdTbl(w, dn, w2, rn, laneN);
+
+		StackFrame sf(this, 4, 1, dn * vn * 2);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		const Reg64& num = sf.p[3];
+		const Reg64& tbl = sf.t[0];
+		const RegExp pX = rsp;
+		const RegExp pY = rsp + dn * vn;
+		const RegExp pP = tbl;
+		const RegExp pP2 = tbl + dn * vn;
+		const Xbyak::Address pinv = ptr [tbl + (dn + rn) * vn];
+		const Xbyak::Address mask = ptr [tbl + (dn + rn + 1) * vn];
+		const Xbyak::Address mask2 = ptr [tbl + (dn + rn + 2) * vn];
+		const Xbyak::Zmm yi = vreg(rn);
+		const Xbyak::Zmm q = vreg(rn + 1);
+		const Xbyak::Zmm tt = vreg(rn + 2);
+		mov(tbl, (size_t)simdTbl_);
+		inLocalLabel();
+	L(".lp");
+		gen_simdLoad(pX, px, w, dn, mask);
+		gen_simdLoad(pY, py, w, dn, mask);
+		int ti[16];
+		for (int i = 0; i < rn; i++) ti[i] = i;
+		for (int i = 0; i < dn; i++) {
+			vmovdqu64(yi, ptr [pY + i * vn]);
+			if (i == 0) {
+				for (int j = 0; j < rn; j++) vpxorq(vreg(j), vreg(j), vreg(j));
+			}
+			// t += x * y[i]
+			for (int j = 0; j < dn; j++) {
+				vpmadd52luq(vreg(ti[j]), yi, ptr [pX + j * vn]);
+				vpmadd52huq(vreg(ti[j + 1]), yi, ptr [pX + j * vn]);
+			}
+			vpxorq(q, q, q);
+			vpmadd52luq(q, vreg(ti[0]), pinv);
+			if (i == dn - 1) vpandq(q, q, mask2);
+			// t += p * q
+			for (int j = 0; j < dn; j++) {
+				vpmadd52luq(vreg(ti[j]), q, ptr [pP + j * vn]);
+				vpmadd52huq(vreg(ti[j + 1]), q, ptr [pP + j * vn]);
+			}
+			if (i == dn - 1) break;
+			// t >>= w
+			vpsrlq(tt, vreg(ti[0]), w);
+			vpaddq(vreg(ti[1]), vreg(ti[1]), tt);
+			vpxorq(vreg(ti[0]), vreg(ti[0]), vreg(ti[0]));
+			const int t0 = ti[0];
+			for (int j = 0; j < rn - 1; j++) ti[j] = ti[j + 1];
+			ti[rn - 1] = t0;
+		}
+		Xbyak::Zmm t[16];
+		for (int j = 0; j < rn; j++) t[j] = vreg(ti[j]);
+		// normalize t ; the top digit keeps the rest
+		for (int j = 0; j < rn - 1; j++) {
+			vpsrlq(tt, t[j], w);
+			vpandq(t[j], t[j], mask);
+			vpaddq(t[j + 1], t[j + 1], tt);
+		}
+		// yi = borrow of t - (p << w2)
+		for (int j = 0; j < rn; j++) {
+			vpsubq(tt, t[j], ptr [pP2 + j * vn]);
+			if (j > 0) vpsubq(tt, tt, yi);
+			vpsrlq(yi, tt, 63);
+		}
+		// q = t < (p << w2) ? -1 : 0
+		vpxorq(q, q, q);
+		vpsubq(q, q, yi);
+		// t -= (p << w2) & ~q
+		for (int j = 0; j < rn; j++) {
+			vpandnq(tt, q, ptr [pP2 + j * vn]);
+			vpsubq(t[j], t[j], tt);
+			if (j > 0) vpsubq(t[j], t[j], yi);
+			if (j == rn - 1) break;
+			vpsrlq(yi, t[j], 63);
+			vpandq(t[j], t[j], mask);
+		}
+		// z = t >> w2
+		for (int k = 0; k < n; k++) {
+			bool first = true;
+			for (int j = 0; j < rn; j++) {
+				const int sh = w * j - (64 * k + w2);
+				if (sh >= 64 || sh <= -64) continue;
+				if (j < rn - 1 && sh <= -w) continue;
+				const Xbyak::Zmm& d = first ? yi : q;
+				if (sh >= 0) {
+					vpsllq(d, t[j], sh);
+				} else {
+					vpsrlq(d, t[j], -sh);
+				}
+				if (!first) vporq(yi, yi, q);
+				first = false;
+			}
+			gen_simdScatter(pz + k * 8, rn);
+		}
+		add(px, laneN * elemN_ * 8);
+		add(py, laneN * elemN_ * 8);
+		add(pz, laneN * elemN_ * 8);
+		sub(num, laneN);
+		jnz(".lp", T_NEAR);
+		outLocalLabel();
+		vzeroupper();
 	}
 	static inline void debug_put_inner(const uint64_t *ptr, int n)
 	{
@@ -804,12 +2422,13 @@ struct FpGenerator : Xbyak::CodeGenerator {
 	void add_m_m(const RegExp& mz, const RegExp& mx, const Reg64& t, int n)
 	{
 		for (int i = 0; i < n; i++) {
-			mov(t, ptr [mx + i * 8]);
+			mov(t, ptr [mz + i * 8]);
 			if (i == 0) {
-				add(ptr [mz + i * 8], t);
+				add(t, ptr [mx + i * 8]);
 			} else {
-				adc(ptr [mz + i * 8], t);
+				adc(t, ptr [mx + i * 8]);
 			}
+			mov(ptr [mz + i * 8], t);
 		}
 	}
 	/*
@@ -1304,6 +2923,48 @@ private:
 		mov(x, rax);
 	}
 
+	/*
+		[rdx:z[k-1..0]] <- py[k-1..0] * x ; k = z.size()
+		x is not used and rdx is the multiplier if useMulx_
+		use rax, rdx
+	*/
+	void mulPack(const Pack& z, const RegExp& py, const Operand& x)
+	{
+		const int k = (int)z.size();
+		if (useMulx_) {
+			if (k == 1) {
+				mulx(rdx, z[0], ptr [py]);
+				return;
+			}
+			mulx(z[1], z[0], ptr [py]);
+			for (int j = 1; j < k - 1; j++) {
+				mulx(z[j + 1], rax, ptr [py + j * 8]);
+				if (j == 1) {
+					add(z[j], rax);
+				} else {
+					adc(z[j], rax);
+				}
+			}
+			mulx(rdx, rax, ptr [py + (k - 1) * 8]);
+			if (k == 2) {
+				add(z[k - 1], rax);
+			} else {
+				adc(z[k - 1], rax);
+			}
+			adc(rdx, 0);
+			return;
+		}
+		mov(rax, ptr [py]);
+		mul(x);
+		mov(z[0], rax);
+		for (int j = 1; j < k; j++) {
+			mov(z[j], rdx);
+			mov(rax, ptr [py + j * 8]);
+			mul(x);
+			add(z[j], rax);
+			adc(rdx, 0);
+		}
+	}
 	/*
 		c = [c3:c2:c1:c0]
 		c += x[2..0] * y
@@ -1332,9 +2993,13 @@ private:
 		}
 		// [t4:c3:y:c1:c0]
 		// t4 = 0 or 1 if isFullBit_, = 0 otherwise
-		mov(rax, pp);
-		mul(c0); // q = rax
-		mov(c2, rax);
+		if (pp == 1) {
+			mov(c2, c0); // q = c0 if p = -1 mod 2^64
+		} else {
+			mov(rax, pp);
+			mul(c0); // q = rax
+			mov(c2, rax);
+		}
 		mul3x1(p, c2, t2, t1, t0, t3);
 		// [rdx:c2:t1:t0] = p * q
 		add(c0, t0); // always c0 is zero
@@ -1373,22 +3038,30 @@ private:
 			mov(ptr [pc + n * 8], rdx);
 		} else {
 			gen_raw_mulI(pw2, px, y, pw1, t, n);
-			mov(t, ptr [pw2 + 0 * 8]);
-			add(ptr [pc + 0 * 8], t);
+			// adc to a register is faster than to memory
+			mov(t, ptr [pc + 0 * 8]);
+			add(t, ptr [pw2 + 0 * 8]);
+			mov(ptr [pc + 0 * 8], t);
 			for (int i = 1; i < n; i++) {
-				mov(t, ptr [pw2 + i * 8]);
-				adc(ptr [pc + i * 8], t);
+				mov(t, ptr [pc + i * 8]);
+				adc(t, ptr [pw2 + i * 8]);
+				mov(ptr [pc + i * 8], t);
 			}
-			adc(ptr [pc + n * 8], rdx);
+			adc(rdx, ptr [pc + n * 8]);
+			mov(ptr [pc + n * 8], rdx);
 			if (isFullBit_) {
 				mov(t, 0);
 				adc(t, 0);
 				mov(qword [pc + (n + 1) * 8], t);
 			}
 		}
-		mov(rax, pp);
-		mul(qword [pc]);
-		mov(y, rax); // y = q
+		if (pp == 1) {
+			mov(y, ptr [pc]);
+		} else {
+			mov(rax, pp);
+			mul(qword [pc]);
+			mov(y, rax); // y = q
+		}
 		gen_raw_mulI(pw2, p, y, pw1, t, n);
 		// c[] = (c[] + pw2[]) >> 64
 		mov(t, ptr [pw2 + 0 * 8]);
@@ -1472,9 +3145,13 @@ private:
 		}
 		// [px:c4:y:c2:c1:c0]
 		// px = 0 or 1 if isFullBit_, = 0 otherwise
-		mov(rax, pp);
-		mul(c0); // q = rax
-		mov(c3, rax);
+		if (pp == 1) {
+			mov(c3, c0);
+		} else {
+			mov(rax, pp);
+			mul(c0); // q = rax
+			mov(c3, rax);
+		}
 		mul4x1(p, c3, t3, t2, t1, t0, t4);
 		add(c0, t0); // always c0 is zero
 		adc(c1, t1);
@@ -42,6 +42,8 @@
 #endif
 #endif
 #endif
+#include <string.h>
+#include <algorithm>
 #include <mie/operator.hpp>
 
 namespace mie {
@@ -75,6 +77,10 @@ struct Gmp {
 	{
 		setRaw(z, &x, 1);
 	}
+	static inline void set(mpz_class& z, int x)
+	{
+		z = x;
+	}
 	static inline bool fromStr(mpz_class& z, const std::string& str, int base = 0)
 	{
 		return z.set_str(str, base) == 0;
@@ -123,6 +129,10 @@ struct Gmp {
 	{
 		mpz_div_ui(q.get_mpz_t(), x.get_mpz_t(), y);
 	}
+	static inline void shr(mpz_class& z, const mpz_class& x, size_t n)
+	{
+		mpz_tdiv_q_2exp(z.get_mpz_t(), x.get_mpz_t(), n);
+	}
 	static inline void mod(mpz_class& r, const mpz_class& x, const mpz_class& m)
 	{
 		mpz_mod(r.get_mpz_t(), x.get_mpz_t(), m.get_mpz_t());
@@ -219,9 +229,45 @@ struct Gmp {
 	}
 };
 
+namespace power_impl {
+
+template<class F>
+struct TagInt;
+
+/*
+	mpz_class as an exponent of power_impl (x >= 0)
+*/
+template<>
+struct TagInt<mpz_class> {
+	typedef Gmp::BlockType BlockType;
+	static size_t getBlockSize(const mpz_class& x)
+	{
+		return Gmp::getBlockSize(x);
+	}
+	static BlockType getBlock(const mpz_class& x, size_t i)
+	{
+		return Gmp::getBlock(x, i);
+	}
+	static size_t getBitLen(const mpz_class& x)
+	{
+		return Gmp::getBitLen(x);
+	}
+	static void shr(mpz_class& x, size_t n)
+	{
+		Gmp::shr(x, x, n);
+	}
+};
+
+} // mie::power_impl
+
 namespace ope {
 
-#if 0
+/*
+	reduction for m = 2^k - c with a small c (Mersenne and pseudo-Mersenne)
+	x = H 2^k + L = H c + L mod m is repeated until x < 2^k
+	it is installed only if 2 * bitLen(c) < k because mpz_mod
+	(division with the precomputed inverse) is faster for other m
+*/
 template<>
 struct Optimized<mpz_class> {
 	Optimized()
@@ -231,34 +277,121 @@ struct Optimized<mpz_class> {
 	bool hasMulMod() const { return hasMulMod_; }
 	void init(const mpz_class& m)
 	{
-		hasMulMod_ = m == getM521();
+		hasMulMod_ = false;
+		if (mpz_sgn(m.get_mpz_t()) <= 0) return;
+		k_ = Gmp::getBitLen(m);
+		mn_ = Gmp::getBlockSize(m);
+		if (mn_ > maxN) return;
+		mpz_class c = mpz_class(1) << k_;
+		c -= m;
+		if (Gmp::isZero(c) || Gmp::getBitLen(c) * 2 >= k_) return;
+		memcpy(m_, Gmp::getBlock(m), mn_ * sizeof(mp_limb_t));
+		cn_ = Gmp::getBlockSize(c);
+		memcpy(c_, Gmp::getBlock(c), cn_ * sizeof(mp_limb_t));
+		hasMulMod_ = true;
+	}
+	void mulMod(mpz_class& z, const mpz_class& x, const mpz_class& y) const
+	{
+		size_t xn = Gmp::getBlockSize(x);
+		size_t yn = Gmp::getBlockSize(y);
+		if (xn == 0 || yn == 0) {
+			Gmp::clear(z);
+			return;
+		}
+		const mp_limb_t *xp = Gmp::getBlock(x);
+		const mp_limb_t *yp = Gmp::getBlock(y);
+		if (xn < yn) {
+			std::swap(xp, yp);
+			std::swap(xn, yn);
+		}
+		mp_limb_t t[maxN * 2 + 2];
+		mpn_mul(t, xp, xn, yp, yn);
+		mod(z, t, xn + yn);
 	}
-	static void mulMod(mpz_class& z, const mpz_class& x, const mpz_class& y)
+	void mulMod(mpz_class& z, const mpz_class& x, unsigned int y) const
 	{
-		z = x * y;
-		modByM521(z, z);
+		const size_t xn = Gmp::getBlockSize(x);
+		if (xn == 0 || y == 0) {
+			Gmp::clear(z);
+			return;
+		}
+		mp_limb_t t[maxN * 2 + 2];
+		t[xn] = mpn_mul_1(t, Gmp::getBlock(x), xn, y);
+		mod(z, t, xn + 1);
 	}
-	static void mulMod(mpz_class& z, const mpz_class& x, unsigned int y)
+	void squareMod(mpz_class& z, const mpz_class& x) const
 	{
-		z = x * y;
-		modByM521(z, z);
+		const size_t xn = Gmp::getBlockSize(x);
+		if (xn == 0) {
+			Gmp::clear(z);
+			return;
+		}
+		mp_limb_t t[maxN * 2 + 2];
+		mpn_sqr(t, Gmp::getBlock(x), xn);
+		mod(z, t, xn * 2);
 	}
 private:
+	static const size_t maxN = 16;
 	bool hasMulMod_;
-	static const mpz_class& getM521()
+	size_t k_;
+	size_t mn_;
+	size_t cn_;
+	mp_limb_t m_[maxN];
+	mp_limb_t c_[maxN];
+	static size_t getNormalizedSize(const mp_limb_t *x, size_t n)
 	{
-		static mpz_class M521("0x1ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
-		return M521;
+		while (n > 0 && x[n - 1] == 0) n--;
+		return n;
 	}
-	static void modByM521(mpz_class& z, const mpz_class& x)
-	{
-		const mpz_class& m = getM521();
-		assert(x < 2 * m);
-		z = (x & m) + (x >> 521);
-		if (z >= m) z -= m;
+	/*
+		z = x mod m for x[0, xn) (x is destroyed)
+	*/
+	void mod(mpz_class& z, mp_limb_t *x, size_t xn) const
+	{
+		const size_t q = k_ / GMP_NUMB_BITS;
+		const size_t r = k_ % GMP_NUMB_BITS;
+		const size_t ln = r ? q + 1 : q; // limbs of L
+		mp_limb_t h[maxN * 2 + 2];
+		for (;;) {
+			xn = getNormalizedSize(x, xn);
+			if (xn <= q) break;
+			// h = x >> k
+			size_t hn = xn - q;
+			if (r) {
+				mpn_rshift(h, x + q, hn, (unsigned int)r);
+			} else {
+				memcpy(h, x + q, hn * sizeof(mp_limb_t));
+			}
+			hn = getNormalizedSize(h, hn);
+			if (hn == 0) break;
+			// x = (x & (2^k - 1)) + h c
+			if (r) x[q] &= (mp_limb_t(1) << r) - 1;
+			for (size_t i = xn; i < ln; i++) x[i] = 0;
+			mp_limb_t t[maxN * 2 + 2];
+			if (hn >= cn_) {
+				mpn_mul(t, h, hn, c_, cn_);
+			} else {
+				mpn_mul(t, c_, cn_, h, hn);
+			}
+			const size_t tn = hn + cn_;
+			if (tn >= ln) {
+				t[tn] = mpn_add(t, t, tn, x, ln);
+				xn = tn + 1;
+				memcpy(x, t, xn * sizeof(mp_limb_t));
+			} else {
+				x[ln] = mpn_add(x, x, ln, t, tn);
+				xn = ln + 1;
+			}
+		}
+		// x < 2^k < 2m
+		for (size_t i = xn; i < mn_; i++) x[i] = 0;
+		if (mpn_cmp(x, m_, mn_) >= 0) mpn_sub_n(x, x, m_, mn_);
+		mpz_ptr zp = z.get_mpz_t();
+		if (size_t(zp->_mp_alloc) < mn_) _mpz_realloc(zp, mn_);
+		memcpy(zp->_mp_d, x, mn_ * sizeof(mp_limb_t));
+		zp->_mp_size = int(getNormalizedSize(x, mn_));
 	}
 };
-#endif
 
 } // mie::ope
 
@@ -13,6 +13,8 @@
 #include <mie/gmp_util.hpp>
 #include <mie/fp.hpp>
 #include <mie/fp_generator.hpp>
+#include <mie/safegcd.hpp>
+#include <mie/tagfield.hpp>
 
 namespace mie {
 
@@ -28,8 +30,15 @@ class MontFpT : public ope::addsub<MontFpT<N, tag>,
 	static MontFpT one_;
 	static MontFpT R_; // (1 << (N * 64)) % p
 	static MontFpT RR_; // (R * R) % p
-	static MontFpT invTbl_[N * 64 * 2];
+	// preInv is generated for N <= 9
+	static const size_t invTblN = N <= 9 ? N * 64 * 2 : 1;
+	static MontFpT invTbl_[invTblN];
+	static safegcd::ModInv<N> modInv_; // gives R^2 / x
+	static int invMode_;
+	static power_impl::FixedExp invExp_; // p - 2
+	static fp::SquareRoot<MontFpT> sq_;
 	static size_t modBitLen_;
+	static const size_t codeSize = N * 2048 > 4096 * 16 ? N * 2048 : 4096 * 16;
 public:
 	static FpGenerator fg_;
 private:
@@ -52,20 +61,71 @@ private:
 		}
 		assert(compare(*this, p_) < 0);
 	}
+	/*
+		preInv(r, x) gives xr = 2^k, then x^-1 = mul(r, invTbl[k])
+		invTbl[k] = R^2 2^-k
+	*/
 	static void initInvTbl(MontFpT *invTbl)
 	{
+		const int n = (int)invTblN;
 		MontFpT t(2);
-		const int n = N * 64 * 2;
 		for (int i = 0; i < n; i++) {
 			invTbl[n - 1 - i] = t;
 			t += t;
 		}
 	}
+	static inline void initFixedExp(power_impl::FixedExp& fe, const mpz_class& e)
+	{
+		uint64_t buf[N];
+		if (Gmp::getRaw(buf, N, e) == 0) {
+			throw cybozu::Exception("MontFpT:initFixedExp") << e;
+		}
+		fe.init(buf, N);
+	}
 	typedef void (*void3op)(MontFpT&, const MontFpT&, const MontFpT&);
 	typedef bool (*bool3op)(MontFpT&, const MontFpT&, const MontFpT&);
 	typedef void (*void2op)(MontFpT&, const MontFpT&);
 	typedef int (*int2op)(MontFpT&, const MontFpT&);
+	typedef void (*void3opN)(MontFpT*, const MontFpT*, const MontFpT*, size_t);
+	typedef void (*void2opN)(MontFpT*, const MontFpT*, size_t);
+	typedef void (*void3opI)(MontFpT&, const MontFpT&, uint64_t);
+	/*
+		small multiples for N > 9 where fg_ does not generate them
+	*/
+	static inline void mulBy2C(MontFpT& z, const MontFpT& x) { add(z, x, x); }
+	static inline void mulBy3C(MontFpT& z, const MontFpT& x)
+	{
+		MontFpT t;
+		add(t, x, x);
+		add(z, t, x);
+	}
+	static inline void mulBy4C(MontFpT& z, const MontFpT& x)
+	{
+		add(z, x, x);
+		add(z, z, z);
+	}
+	static inline void mulBy8C(MontFpT& z, const MontFpT& x)
+	{
+		add(z, x, x);
+		add(z, z, z);
+		add(z, z, z);
+	}
+	static inline void sub2C(MontFpT& z, const MontFpT& x, const MontFpT& y)
+	{
+		MontFpT t;
+		add(t, y, y);
+		sub(z, x, t);
+	}
 public:
+	/*
+		algorithm of inv (selected per tag by setInvMode)
+		InvPre : preInv and invTbl_ (default, running time depends on x)
+		InvSafeGcd : constant time safegcd without table
+		InvFermat : constant time x^(p - 2)
+	*/
+	enum { InvPre, InvSafeGcd, InvFermat };
+	static inline void setInvMode(int mode) { invMode_ = mode; }
+	static inline int getInvMode() { return invMode_; }
 	static const size_t BlockSize = N;
 	typedef uint64_t BlockType;
 	MontFpT() {}
@@ -101,9 +161,14 @@ public:
 		bool isMinus;
 		const char *p = fp::verifyStr(&isMinus, &base, str);
 
-		if (base == 16) {
+		if (base == 16 || base == 10) {
 			MontFpT t;
-			mie::fp::fromStr16(t.v_, N, p, str.size() - (p - str.c_str()));
+			const size_t len = str.size() - (p - str.c_str());
+			if (base == 16) {
+				mie::fp::fromStr16(t.v_, N, p, len);
+			} else {
+				mie::fp::fromStr10(t.v_, N, p, len);
+			}
 			if (compare(t, p_) >= 0) throw cybozu::Exception("fp:MontFpT:str is too large") << str;
 			mul(*this, t, RR_);
 		} else {
@@ -142,10 +207,9 @@ public:
 			return;
 		}
 		if (base != 10) throw cybozu::Exception("fp:MontFpT:toStr:bad base") << base;
-		// QQQ : remove conversion to gmp
-		mpz_class t;
-		fromMont(t, *this);
-		Gmp::toStr(str, t, base);
+		MontFpT t;
+		mul(t, *this, one_);
+		mie::fp::toStr10<N>(str, t.v_, N);
 	}
 	std::string toStr(int base = 10, bool withPrefix = false) const
 	{
@@ -153,6 +217,163 @@ public:
 		toStr(str, base, withPrefix);
 		return str;
 	}
+	/*
+		str[i] = x[i].toStr(base) for i < n
+		convert x from Montgomery form by mulLoop in blocks
+	*/
+	static void toStrVec(std::string *str, const MontFpT *x, size_t n, int base = 10)
+	{
+		const size_t blockN = 16;
+		MontFpT t[blockN], oneTbl[blockN];
+		for (size_t i = 0; i < blockN; i++) oneTbl[i] = one_;
+		for (size_t i = 0; i < n; i += blockN) {
+			const size_t m = std::min(blockN, n - i);
+			mulLoop(t, x + i, oneTbl, m);
+			for (size_t j = 0; j < m; j++) {
+				switch (base) {
+				case 10:
+					mie::fp::toStr10<N>(str[i + j], t[j].v_, N);
+					break;
+				case 16:
+					mie::fp::toStr16(str[i + j], t[j].v_, N);
+					break;
+				case 2:
+					mie::fp::toStr2(str[i + j], t[j].v_, N, false);
+					break;
+				default:
+					throw cybozu::Exception("fp:MontFpT:toStrVec:bad base") << base;
+				}
+			}
+		}
+	}
+	/*
+		x[i].fromStr(str[i], base) for i < n
+		decimal and hex strings are converted to Montgomery form by mulLoop in blocks
+	*/
+	static void fromStrVec(MontFpT *x, const std::string *str, size_t n, int base = 0)
+	{
+		const size_t blockN = 16;
+		MontFpT t[blockN], rrTbl[blockN];
+		bool isMinus[blockN];
+		for (size_t i = 0; i < blockN; i++) rrTbl[i] = RR_;
+		for (size_t i = 0; i < n; i += blockN) {
+			const size_t m = std::min(blockN, n - i);
+			for (size_t j = 0; j < m; j++) {
+				const std::string& s = str[i + j];
+				int b = base;
+				const char *p = fp::verifyStr(&isMinus[j], &b, s);
+				const size_t len = s.size() - (p - s.c_str());
+				if (b == 10) {
+					mie::fp::fromStr10(t[j].v_, N, p, len);
+				} else if (b == 16) {
+					mie::fp::fromStr16(t[j].v_, N, p, len);
+				} else {
+					throw cybozu::Exception("fp:MontFpT:fromStrVec:bad base") << b;
+				}
+				if (compare(t[j], p_) >= 0) throw cybozu::Exception("fp:MontFpT:fromStrVec:str is too large") << s;
+			}
+			mulLoop(x + i, t, rrTbl, m);
+			for (size_t j = 0; j < m; j++) {
+				if (isMinus[j]) neg(x[i + j], x[i + j]);
+			}
+		}
+	}
+	/*
+		fixed size of serialize in bytes
+	*/
+	static inline size_t getByteSize() { return (modBitLen_ + 7) / 8; }
+	/*
+		write getByteSize() bytes of x in little endian to buf and return the size
+		isMont = false : canonical value in [0, p)
+		isMont = true : raw Montgomery form xR mod p (no conversion, valid only for the same p and R)
+	*/
+	size_t serialize(void *buf, size_t maxBufSize, bool isMont = false) const
+	{
+		const size_t byteSize = getByteSize();
+		if (maxBufSize < byteSize) throw cybozu::Exception("fp:MontFpT:serialize:small buffer") << maxBufSize << byteSize;
+		if (isMont) {
+			fp::copyToLE(buf, byteSize, v_, N);
+		} else {
+			MontFpT t;
+			mul(t, *this, one_);
+			fp::copyToLE(buf, byteSize, t.v_, N);
+		}
+		return byteSize;
+	}
+	/*
+		read getByteSize() bytes from buf and return the size
+		throw if the value is not less than p
+	*/
+	size_t deserialize(const void *buf, size_t bufSize, bool isMont = false)
+	{
+		const size_t byteSize = getByteSize();
+		if (bufSize < byteSize) throw cybozu::Exception("fp:MontFpT:deserialize:small buffer") << bufSize << byteSize;
+		MontFpT t;
+		fp::copyFromLE(t.v_, N, buf, byteSize);
+		if (compare(t, p_) >= 0) throw cybozu::Exception("fp:MontFpT:deserialize:too large");
+		if (isMont) {
+			*this = t;
+		} else {
+			mul(*this, t, RR_);
+		}
+		return byteSize;
+	}
+	/*
+		serialize x[0], ..., x[n - 1] to contiguous buf and return the total size
+		canonical values are converted by mulLoop in blocks
+		if getByteSize() == sizeof(MontFpT) then the Montgomery form of buf
+		is the same as the memory of x
+	*/
+	static size_t serializeVec(void *buf, size_t maxBufSize, const MontFpT *x, size_t n, bool isMont = false)
+	{
+		const size_t byteSize = getByteSize();
+		if (maxBufSize / byteSize < n) throw cybozu::Exception("fp:MontFpT:serializeVec:small buffer") << maxBufSize << n;
+		char *p = (char*)buf;
+		if (isMont) {
+			if (byteSize == sizeof(MontFpT)) {
+				memcpy(p, x, byteSize * n);
+			} else {
+				for (size_t i = 0; i < n; i++) {
+					fp::copyToLE(p + byteSize * i, byteSize, x[i].v_, N);
+				}
+			}
+			return byteSize * n;
+		}
+		const size_t blockN = 16;
+		MontFpT t[blockN], oneTbl[blockN];
+		for (size_t i = 0; i < blockN; i++) oneTbl[i] = one_;
+		for (size_t i = 0; i < n; i += blockN) {
+			const size_t m = std::min(blockN, n - i);
+			mulLoop(t, x + i, oneTbl, m);
+			for (size_t j = 0; j < m; j++) {
+				fp::copyToLE(p + byteSize * (i + j), byteSize, t[j].v_, N);
+			}
+		}
+		return byteSize * n;
+	}
+	/*
+		deserialize x[0], ..., x[n - 1] from contiguous buf and return the total size
+		throw if one of values is not less than p
+	*/
+	static size_t deserializeVec(MontFpT *x, size_t n, const void *buf, size_t bufSize, bool isMont = false)
+	{
+		const size_t byteSize = getByteSize();
+		if (bufSize / byteSize < n) throw cybozu::Exception("fp:MontFpT:deserializeVec:small buffer") << bufSize << n;
+		const char *p = (const char*)buf;
+		const size_t blockN = 16;
+		MontFpT t[blockN], rrTbl[blockN];
+		for (size_t i = 0; i < blockN; i++) rrTbl[i] = RR_;
+		for (size_t i = 0; i < n; i += blockN) {
+			const size_t m = std::min(blockN, n - i);
+			MontFpT *q = isMont ? x + i : t;
+			for (size_t j = 0; j < m; j++) {
+				fp::copyFromLE(q[j].v_, N, p + byteSize * (i + j), byteSize);
+				if (compare(q[j], p_) >= 0) throw cybozu::Exception("fp:MontFpT:deserializeVec:too large") << (i + j);
+			}
+			if (!isMont) mulLoop(x + i, t, rrTbl, m);
+		}
+		return byteSize * n;
+	}
 	void clear()
 	{
 		for (size_t i = 0; i < N; i++) v_[i] = 0;
@@ -189,22 +410,61 @@ public:
 			throw cybozu::Exception("MontFp:setModulo:bad prime length") << pstr;
 		}
 		p_.fromRawGmp(pOrg_);
+		fg_.init(p_.v_, N);
 		mpz_class t = 1;
 		one_.fromRawGmp(t);
 		t = (t << (N * 64)) % pOrg_;
 		R_.fromRawGmp(t);
 		t = (t * t) % pOrg_;
 		RR_.fromRawGmp(t);
-		fg_.init(p_.v_, N);
 		add = Xbyak::CastTo<void3op>(fg_.add_);
 		sub = Xbyak::CastTo<void3op>(fg_.sub_);
 		mul = Xbyak::CastTo<void3op>(fg_.mul_);
+		sqr = Xbyak::CastTo<void2op>(fg_.sqr_);
 		neg = Xbyak::CastTo<void2op>(fg_.neg_);
 		shr1 = Xbyak::CastTo<void2op>(fg_.shr1_);
 		addNc = Xbyak::CastTo<bool3op>(fg_.addNc_);
 		subNc = Xbyak::CastTo<bool3op>(fg_.subNc_);
 		preInv = Xbyak::CastTo<int2op>(fg_.preInv_);
-		initInvTbl(invTbl_);
+		addVec = Xbyak::CastTo<void3opN>(fg_.addVec_);
+		subVec = Xbyak::CastTo<void3opN>(fg_.subVec_);
+		negVec = Xbyak::CastTo<void2opN>(fg_.negVec_);
+		mulLoop = Xbyak::CastTo<void3opN>(fg_.mulVec_);
+		mulSimd = Xbyak::CastTo<void3opN>(fg_.mulSimd_);
+		if (fg_.mulBy2_) {
+			mulBy2 = Xbyak::CastTo<void2op>(fg_.mulBy2_);
+			mulBy3 = Xbyak::CastTo<void2op>(fg_.mulBy3_);
+			mulBy4 = Xbyak::CastTo<void2op>(fg_.mulBy4_);
+			mulBy8 = Xbyak::CastTo<void2op>(fg_.mulBy8_);
+			sub2 = Xbyak::CastTo<void3op>(fg_.sub2_);
+		} else {
+			mulBy2 = mulBy2C;
+			mulBy3 = mulBy3C;
+			mulBy4 = mulBy4C;
+			mulBy8 = mulBy8C;
+			sub2 = sub2C;
+		}
+		mulUnit = Xbyak::CastTo<void3opI>(fg_.mulUnit_);
+		if (preInv) initInvTbl(invTbl_);
+		modInv_.init(p_.v_, modBitLen_, RR_.v_);
+		initFixedExp(invExp_, pOrg_ - 2);
+		sq_.init(p_.v_, N);
+	}
+	/*
+		use the reduction for a pseudo-Mersenne or Mersenne prime if p is such one
+		call before setModulo (on by default) ; the values are xR mod p in both cases
+	*/
+	static inline void setUseSpecialMod(bool useSpecialMod)
+	{
+		fg_.useSpecialMod_ = useSpecialMod;
+	}
+	/*
+		use the AVX-512 IFMA kernel in mulVec if the cpu has it
+		call before setModulo (off by default)
+	*/
+	static inline void setUseIfmaSimd(bool useIfmaSimd)
+	{
+		fg_.useIfmaSimd_ = useIfmaSimd;
 	}
 	static inline void getModulo(std::string& pstr)
 	{
@@ -226,14 +486,48 @@ public:
 	static void3op add;
 	static void3op sub;
 	static void3op mul;
+	static void2op sqr;
 	static void2op neg;
 	static void2op shr1;
 	static bool3op addNc;
 	static bool3op subNc;
 	static int2op preInv;
+	/*
+		z[i] = x[i] op y[i] for i < n (z may be x or y)
+	*/
+	static void3opN addVec;
+	static void3opN subVec;
+	static void2opN negVec;
+	static void3opN mulLoop; // mulVec without SIMD
+	static void3opN mulSimd;
+	/*
+		z = c * x for c = 2, 3, 4, 8
+		sub2(z, x, y) ; z = x - 2y
+		mulUnit(z, x, c) ; z = c * x for c < 2^63
+	*/
+	static void2op mulBy2;
+	static void2op mulBy3;
+	static void2op mulBy4;
+	static void2op mulBy8;
+	static void3op sub2;
+	static void3opI mulUnit;
 	static inline void square(MontFpT& z, const MontFpT& x)
 	{
-		mul(z, x, x);
+		sqr(z, x);
+	}
+	/*
+		z[i] = x[i] * y[i] for i < n
+		use SIMD lanes of fg_ (AVX-512 IFMA by setUseIfmaSimd) for blocks of fg_.simdN_ elements
+		and mulLoop for the rest
+	*/
+	static inline void mulVec(MontFpT *z, const MontFpT *x, const MontFpT *y, size_t n)
+	{
+		size_t done = 0;
+		if (mulSimd) {
+			done = n - n % fg_.simdN_;
+			if (done) mulSimd(z, x, y, done);
+		}
+		mulLoop(z + done, x + done, y + done, n - done);
 	}
 	static inline int preInvC(MontFpT& r, const MontFpT& x)
 	{
@@ -278,8 +572,61 @@ public:
 		}
 		return k;
 	}
+	/*
+		powers by the exponents fixed at setModulo
+	*/
+	// z = x^(p - 2) = x^-1 (z = 0 if x = 0)
+	static inline void invFermat(MontFpT& z, const MontFpT& x)
+	{
+		invExp_.power(z, x);
+	}
+	/*
+		z = sqrt(x) and return true if x is a square, return false otherwise
+		p = 3 mod 4 : x^((p + 1) / 4), p = 5 mod 8 : Atkin, otherwise Tonelli-Shanks
+	*/
+	static inline bool sqrt(MontFpT& z, const MontFpT& x)
+	{
+		return sq_.get(z, x);
+	}
+	/*
+		x^((p - 1) / 2)
+		return 1 if x is a square, -1 if not, 0 if x = 0
+	*/
+	static inline int legendre(const MontFpT& x)
+	{
+		return sq_.legendre(x);
+	}
+	/*
+		by the Jacobi symbol without exponentiation
+		(xR / p) = (x / p) because R = 2^(64N) is a square
+	*/
+	static inline bool isSquare(const MontFpT& x)
+	{
+		uint64_t a[N], m[N];
+		for (size_t i = 0; i < N; i++) {
+			a[i] = x.v_[i];
+			m[i] = p_.v_[i];
+		}
+		return fp::jacobi(a, m, N) >= 0;
+	}
 	static inline void inv(MontFpT& z, const MontFpT& x)
 	{
+		if (invMode_ == InvSafeGcd) {
+			// (xR)^-1 R^2 = x^-1 R
+			modInv_.inv(z.v_, x.v_);
+			return;
+		}
+		if (invMode_ == InvFermat) {
+			invFermat(z, x);
+			return;
+		}
+		if (preInv == 0) {
+			mpz_class t;
+			fromMont(t, x);
+			Gmp::invMod(t, t, pOrg_);
+			toMont(z, t);
+			return;
+		}
 #if 1
 		MontFpT r;
 #if 1
@@ -310,6 +657,14 @@ public:
 		toMont(z, t);
 #endif
 	}
+	/*
+		y[i] = 1 / x[i] for i < n by one inv and 3(n - 1) mul
+		y[i] = 0 if x[i] = 0 (y may be x)
+	*/
+	static inline void invVec(MontFpT *y, const MontFpT *x, size_t n)
+	{
+		fp::invVec(y, x, n);
+	}
 	static inline void div(MontFpT& z, const MontFpT& x, const MontFpT& y)
 	{
 		MontFpT ry;
@@ -354,11 +709,17 @@ public:
 		return r == 0;
 	}
 	bool isZero() const { return isZero(*this); }
+	/*
+		z = x^y by the sliding window method (y may be negative)
+	*/
 	template<class Z>
 	static void power(MontFpT& z, const MontFpT& x, const Z& y)
 	{
-		power_impl::power(z, x, y);
+		power_impl::powerWindow(z, x, y);
 	}
+	/*
+		xR mod p
+	*/
 	const uint64_t* getInnerValue() const { return v_; }
 	bool operator==(const MontFpT& rhs) const { return compare(*this, rhs) == 0; }
 	bool operator!=(const MontFpT& rhs) const { return compare(*this, rhs) != 0; }
@@ -370,18 +731,738 @@ template<size_t N, class tag>MontFpT<N, tag> MontFpT<N, tag>::p_;
 template<size_t N, class tag>MontFpT<N, tag> MontFpT<N, tag>::one_;
 template<size_t N, class tag>MontFpT<N, tag> MontFpT<N, tag>::R_;
 template<size_t N, class tag>MontFpT<N, tag> MontFpT<N, tag>::RR_;
-template<size_t N, class tag>MontFpT<N, tag> MontFpT<N, tag>::invTbl_[N * 64 * 2];
-template<size_t N, class tag>FpGenerator MontFpT<N, tag>::fg_;
+template<size_t N, class tag>MontFpT<N, tag> MontFpT<N, tag>::invTbl_[MontFpT<N, tag>::invTblN];
+template<size_t N, class tag>safegcd::ModInv<N> MontFpT<N, tag>::modInv_;
+template<size_t N, class tag>int MontFpT<N, tag>::invMode_ = MontFpT<N, tag>::InvPre;
+template<size_t N, class tag>power_impl::FixedExp MontFpT<N, tag>::invExp_;
+template<size_t N, class tag>fp::SquareRoot<MontFpT<N, tag> > MontFpT<N, tag>::sq_;
+template<size_t N, class tag>FpGenerator MontFpT<N, tag>::fg_(MontFpT<N, tag>::codeSize);
 template<size_t N, class tag>size_t MontFpT<N, tag>::modBitLen_;
 
 template<size_t N, class tag>typename MontFpT<N, tag>::void3op MontFpT<N, tag>::add;
 template<size_t N, class tag>typename MontFpT<N, tag>::void3op MontFpT<N, tag>::sub;
 template<size_t N, class tag>typename MontFpT<N, tag>::void3op MontFpT<N, tag>::mul;
+template<size_t N, class tag>typename MontFpT<N, tag>::void2op MontFpT<N, tag>::sqr;
 template<size_t N, class tag>typename MontFpT<N, tag>::void2op MontFpT<N, tag>::neg;
 template<size_t N, class tag>typename MontFpT<N, tag>::void2op MontFpT<N, tag>::shr1;
 template<size_t N, class tag>typename MontFpT<N, tag>::bool3op MontFpT<N, tag>::addNc;
 template<size_t N, class tag>typename MontFpT<N, tag>::bool3op MontFpT<N, tag>::subNc;
 template<size_t N, class tag>typename MontFpT<N, tag>::int2op MontFpT<N, tag>::preInv;
+template<size_t N, class tag>typename MontFpT<N, tag>::void3opN MontFpT<N, tag>::addVec;
+template<size_t N, class tag>typename MontFpT<N, tag>::void3opN MontFpT<N, tag>::subVec;
+template<size_t N, class tag>typename MontFpT<N, tag>::void2opN MontFpT<N, tag>::negVec;
+template<size_t N, class tag>typename MontFpT<N, tag>::void3opN MontFpT<N, tag>::mulLoop;
+template<size_t N, class tag>typename MontFpT<N, tag>::void3opN MontFpT<N, tag>::mulSimd;
+template<size_t N, class tag>typename MontFpT<N, tag>::void2op MontFpT<N, tag>::mulBy2;
+template<size_t N, class tag>typename MontFpT<N, tag>::void2op MontFpT<N, tag>::mulBy3;
+template<size_t N, class tag>typename MontFpT<N, tag>::void2op MontFpT<N, tag>::mulBy4;
+template<size_t N, class tag>typename MontFpT<N, tag>::void2op MontFpT<N, tag>::mulBy8;
+template<size_t N, class tag>typename MontFpT<N, tag>::void3op MontFpT<N, tag>::sub2;
+template<size_t N, class tag>typename MontFpT<N, tag>::void3opI MontFpT<N, tag>::mulUnit;
+
+/*
+	double width value for lazy reduction of MontFpT<N, tag>
+	x is kept in [0, p * 2^(64N)) and mod(z, x) gives z = x / 2^(64N) mod p
+	so that mod(z, mulPre(x, y)) is same as MontFpT::mul(z, x, y)
+	ex. z = a * b + c * d needs one reduction
+	mulPre(t1, a, b); mulPre(t2, c, d); add(t1, t1, t2); mod(z, t1);
+*/
+template<size_t N, class tag = fp_local::TagDefault>
+class MontFpDblT {
+	typedef MontFpT<N, tag> Fp;
+	uint64_t v_[N * 2];
+	typedef void (*void3op)(MontFpDblT&, const MontFpDblT&, const MontFpDblT&);
+	typedef bool (*bool3op)(MontFpDblT&, const MontFpDblT&, const MontFpDblT&);
+	typedef void (*mulPreOp)(MontFpDblT&, const Fp&, const Fp&);
+	typedef void (*modOp)(Fp&, const MontFpDblT&);
+public:
+	static const size_t BlockSize = N * 2;
+	typedef uint64_t BlockType;
+	MontFpDblT() {}
+	void clear()
+	{
+		for (size_t i = 0; i < N * 2; i++) v_[i] = 0;
+	}
+	/*
+		z = x * y
+	*/
+	static inline void mulPre(MontFpDblT& z, const Fp& x, const Fp& y)
+	{
+		Xbyak::CastTo<mulPreOp>(Fp::fg_.mulPre_)(z, x, y);
+	}
+	static inline void sqrPre(MontFpDblT& z, const Fp& x)
+	{
+		mulPre(z, x, x);
+	}
+	/*
+		z = x / 2^(64N) mod p
+	*/
+	static inline void mod(Fp& z, const MontFpDblT& x)
+	{
+		Xbyak::CastTo<modOp>(Fp::fg_.mod_)(z, x);
+	}
+	/*
+		z = x +/- y mod p * 2^(64N)
+	*/
+	static inline void add(MontFpDblT& z, const MontFpDblT& x, const MontFpDblT& y)
+	{
+		Xbyak::CastTo<void3op>(Fp::fg_.addDbl_)(z, x, y);
+	}
+	static inline void sub(MontFpDblT& z, const MontFpDblT& x, const MontFpDblT& y)
+	{
+		Xbyak::CastTo<void3op>(Fp::fg_.subDbl_)(z, x, y);
+	}
+	/*
+		z = x +/- y without reduction ; return carry
+		the caller must keep z in [0, p * 2^(64N)) before mod
+	*/
+	static inline bool addNc(MontFpDblT& z, const MontFpDblT& x, const MontFpDblT& y)
+	{
+		return Xbyak::CastTo<bool3op>(Fp::fg_.addDblNc_)(z, x, y);
+	}
+	static inline bool subNc(MontFpDblT& z, const MontFpDblT& x, const MontFpDblT& y)
+	{
+		return Xbyak::CastTo<bool3op>(Fp::fg_.subDblNc_)(z, x, y);
+	}
+	const uint64_t* getInnerValue() const { return v_; }
+	bool operator==(const MontFpDblT& rhs) const
+	{
+		for (size_t i = 0; i < N * 2; i++) {
+			if (v_[i] != rhs.v_[i]) return false;
+		}
+		return true;
+	}
+	bool operator!=(const MontFpDblT& rhs) const { return !operator==(rhs); }
+};
+
+/*
+	field context of MontFpT which owns its modulus, constants and generated code
+	so that several moduli can be used at the same time without tag types
+	all the operations are const and do not touch global state,
+	then threads may share a context or use their own ones
+	ex.
+	MontFpContext<4> ctx(pStr);
+	MontFpContext<4>::Elem x, y;
+	ctx.set(x, 3); ctx.set(y, "123");
+	ctx.mul(x, x, y);
+*/
+template<size_t N>
+class MontFpContext {
+public:
+	class Elem {
+		friend class MontFpContext;
+		uint64_t v_[N];
+	public:
+		void clear()
+		{
+			for (size_t i = 0; i < N; i++) v_[i] = 0;
+		}
+		bool isZero() const
+		{
+			uint64_t r = 0;
+			for (size_t i = 0; i < N; i++) r |= v_[i];
+			return r == 0;
+		}
+		const uint64_t* getInnerValue() const { return v_; }
+		bool operator==(const Elem& rhs) const
+		{
+			for (size_t i = 0; i < N; i++) {
+				if (v_[i] != rhs.v_[i]) return false;
+			}
+			return true;
+		}
+		bool operator!=(const Elem& rhs) const { return !operator==(rhs); }
+	};
+private:
+	static const size_t codeSize = N * 2048 > 4096 * 16 ? N * 2048 : 4096 * 16;
+	mpz_class pOrg_;
+	uint64_t p_[N];
+	Elem one_; // 1 (not Montgomery form)
+	Elem R_; // R % p
+	Elem RR_; // (R * R) % p
+	size_t modBitLen_;
+	FpGenerator fg_;
+	safegcd::ModInv<N> modInv_;
+	void fromRawGmp(uint64_t *z, const mpz_class& x) const
+	{
+		if (Gmp::getRaw(z, N, x) == 0) {
+			throw cybozu::Exception("MontFpContext:fromRawGmp") << x;
+		}
+	}
+	bool isLessThanP(const Elem& x) const
+	{
+		for (size_t i = N; i > 0; i--) {
+			if (x.v_[i - 1] != p_[i - 1]) return x.v_[i - 1] < p_[i - 1];
+		}
+		return false;
+	}
+	/*
+		operations of power_impl::powerWindow
+	*/
+	struct PowerOp {
+		const MontFpContext& c;
+		explicit PowerOp(const MontFpContext& c) : c(c) {}
+		void square(Elem& z, const Elem& x) const { c.square(z, x); }
+		void mul(Elem& z, const Elem& x, const Elem& y) const { c.mul(z, x, y); }
+		void inv(Elem& z, const Elem& x) const { c.inv(z, x); }
+		void init(Elem& z) const { z = c.R_; }
+	};
+	typedef FpGenerator::void3op void3op;
+	typedef FpGenerator::void2op void2op;
+	typedef FpGenerator::void3opN void3opN;
+	typedef FpGenerator::void2opN void2opN;
+	MontFpContext(const MontFpContext&);
+	void operator=(const MontFpContext&);
+public:
+	/*
+		useIfmaSimd : use the AVX-512 IFMA kernel in mulVec if the cpu has it
+	*/
+	explicit MontFpContext(const std::string& pstr, int base = 0, bool useIfmaSimd = false)
+		: fg_(codeSize)
+	{
+		fg_.useIfmaSimd_ = useIfmaSimd;
+		bool isMinus;
+		const char *p = fp::verifyStr(&isMinus, &base, pstr);
+		if (isMinus || !Gmp::fromStr(pOrg_, p, base)) {
+			throw cybozu::Exception("MontFpContext:bad prime") << pstr << base;
+		}
+		modBitLen_ = Gmp::getBitLen(pOrg_);
+		if (fp::getRoundNum(modBitLen_, 64) != N) {
+			throw cybozu::Exception("MontFpContext:bad prime length") << pstr;
+		}
+		fromRawGmp(p_, pOrg_);
+		fg_.init(p_, N);
+		mpz_class t = 1;
+		fromRawGmp(one_.v_, t);
+		t = (t << (N * 64)) % pOrg_;
+		fromRawGmp(R_.v_, t);
+		t = (t * t) % pOrg_;
+		fromRawGmp(RR_.v_, t);
+		modInv_.init(p_, modBitLen_, RR_.v_);
+	}
+	const mpz_class& getModulo() const { return pOrg_; }
+	size_t getModBitLen() const { return modBitLen_; }
+	const FpGenerator& getGenerator() const { return fg_; }
+	void set(Elem& z, int x) const
+	{
+		z.clear();
+		if (x == 0) return;
+		z.v_[0] = x < 0 ? uint64_t(-int64_t(x)) : uint64_t(x);
+		mul(z, z, RR_);
+		if (x < 0) neg(z, z);
+	}
+	void set(Elem& z, const mpz_class& x) const
+	{
+		if (x < 0 || x >= pOrg_) throw cybozu::Exception("MontFpContext:set:bad x") << x;
+		fromRawGmp(z.v_, x);
+		mul(z, z, RR_);
+	}
+	void set(Elem& z, const std::string& str, int base = 0) const
+	{
+		bool isMinus;
+		const char *p = fp::verifyStr(&isMinus, &base, str);
+		if (base == 16 || base == 10) {
+			Elem t;
+			const size_t len = str.size() - (p - str.c_str());
+			if (base == 16) {
+				fp::fromStr16(t.v_, N, p, len);
+			} else {
+				fp::fromStr10(t.v_, N, p, len);
+			}
+			if (!isLessThanP(t)) throw cybozu::Exception("MontFpContext:set:str is too large") << str;
+			mul(z, t, RR_);
+		} else {
+			mpz_class t;
+			if (!Gmp::fromStr(t, p, base)) {
+				throw cybozu::Exception("MontFpContext:set") << str;
+			}
+			set(z, t);
+		}
+		if (isMinus) neg(z, z);
+	}
+	void get(mpz_class& z, const Elem& x) const
+	{
+		Elem t;
+		mul(t, x, one_);
+		Gmp::setRaw(z, t.v_, N);
+	}
+	std::string toStr(const Elem& x, int base = 10) const
+	{
+		if (x.isZero()) return "0";
+		Elem t;
+		mul(t, x, one_);
+		std::string str;
+		switch (base) {
+		case 10:
+			fp::toStr10<N>(str, t.v_, N);
+			break;
+		case 16:
+			fp::toStr16(str, t.v_, N);
+			break;
+		case 2:
+			fp::toStr2(str, t.v_, N, false);
+			break;
+		default:
+			throw cybozu::Exception("MontFpContext:toStr:bad base") << base;
+		}
+		return str;
+	}
+	void add(Elem& z, const Elem& x, const Elem& y) const
+	{
+		Xbyak::CastTo<void3op>(fg_.add_)(z.v_, x.v_, y.v_);
+	}
+	void sub(Elem& z, const Elem& x, const Elem& y) const
+	{
+		Xbyak::CastTo<void3op>(fg_.sub_)(z.v_, x.v_, y.v_);
+	}
+	void mul(Elem& z, const Elem& x, const Elem& y) const
+	{
+		Xbyak::CastTo<void3op>(fg_.mul_)(z.v_, x.v_, y.v_);
+	}
+	void square(Elem& z, const Elem& x) const
+	{
+		Xbyak::CastTo<void2op>(fg_.sqr_)(z.v_, x.v_);
+	}
+	void neg(Elem& z, const Elem& x) const
+	{
+		Xbyak::CastTo<void2op>(fg_.neg_)(z.v_, x.v_);
+	}
+	/*
+		constant time safegcd (z = 0 if x = 0)
+	*/
+	void inv(Elem& z, const Elem& x) const
+	{
+		modInv_.inv(z.v_, x.v_);
+	}
+	void div(Elem& z, const Elem& x, const Elem& y) const
+	{
+		Elem t;
+		inv(t, y);
+		mul(z, x, t);
+	}
+	/*
+		z = x^e for e >= 0 by the sliding window method
+	*/
+	void power(Elem& z, const Elem& x, const mpz_class& e) const
+	{
+		if (e < 0) throw cybozu::Exception("MontFpContext:power:negative e") << e;
+		power_impl::powerWindow(z, x, e, PowerOp(*this));
+	}
+	/*
+		z[i] = x[i] op y[i] for i < n
+	*/
+	void addVec(Elem *z, const Elem *x, const Elem *y, size_t n) const
+	{
+		Xbyak::CastTo<void3opN>(fg_.addVec_)(z[0].v_, x[0].v_, y[0].v_, n);
+	}
+	void subVec(Elem *z, const Elem *x, const Elem *y, size_t n) const
+	{
+		Xbyak::CastTo<void3opN>(fg_.subVec_)(z[0].v_, x[0].v_, y[0].v_, n);
+	}
+	void negVec(Elem *z, const Elem *x, size_t n) const
+	{
+		Xbyak::CastTo<void2opN>(fg_.negVec_)(z[0].v_, x[0].v_, n);
+	}
+	void mulVec(Elem *z, const Elem *x, const Elem *y, size_t n) const
+	{
+		size_t done = 0;
+		if (fg_.mulSimd_) {
+			done = n - n % fg_.simdN_;
+			if (done) Xbyak::CastTo<void3opN>(fg_.mulSimd_)(z[0].v_, x[0].v_, y[0].v_, done);
+		}
+		if (n > done) Xbyak::CastTo<void3opN>(fg_.mulVec_)(z[done].v_, x[done].v_, y[done].v_, n - done);
+	}
+};
+
+/*
+	Montgomery Fp whose number of limbs N is chosen from p at setModulo
+	(2 <= N <= maxN), so one type covers p of 65 bits to 576 bits
+	every value has maxN limbs and the operations use the code of fg_ for N limbs,
+	then arrays are contiguous with the stride maxN and there is no memory allocation
+	the limbs above N are not used
+	typedef mie::DynMontFpT<> Fp;
+	Fp::setModulo(pStr); // N is given by the bit length of pStr
+*/
+template<class tag = fp_local::TagDefault>
+class DynMontFpT : public ope::addsub<DynMontFpT<tag>,
+	ope::mulable<DynMontFpT<tag>,
+	ope::invertible<DynMontFpT<tag>,
+	ope::hasNegative<DynMontFpT<tag>,
+	ope::hasIO<DynMontFpT<tag> > > > > > {
+public:
+	// the limit of the unrolled code and preInv of FpGenerator
+	static const size_t maxN = 9;
+private:
+	static mpz_class pOrg_;
+	static DynMontFpT p_;
+	static DynMontFpT one_;
+	static DynMontFpT R_; // (1 << (N * 64)) % p
+	static DynMontFpT RR_; // (R * R) % p
+	static DynMontFpT invTbl_[maxN * 64 * 2];
+	static safegcd::ModInv<maxN> modInv_; // gives R^2 / x
+	static int invMode_;
+	static size_t N_;
+	static size_t modBitLen_;
+	static FpGenerator fg_;
+	uint64_t v_[maxN];
+	void fromRawGmp(const mpz_class& x)
+	{
+		clear();
+		if (Gmp::getRaw(v_, N_, x) == 0) {
+			throw cybozu::Exception("DynMontFpT:fromRawGmp") << x;
+		}
+	}
+	/*
+		invTbl[k] = R^2 2^-k (see MontFpT::initInvTbl)
+	*/
+	static void initInvTbl(DynMontFpT *invTbl)
+	{
+		const int n = int(N_ * 64 * 2);
+		DynMontFpT t(2);
+		for (int i = 0; i < n; i++) {
+			invTbl[n - 1 - i] = t;
+			t += t;
+		}
+	}
+	typedef void (*void3op)(DynMontFpT&, const DynMontFpT&, const DynMontFpT&);
+	typedef void (*void2op)(DynMontFpT&, const DynMontFpT&);
+	typedef int (*int2op)(DynMontFpT&, const DynMontFpT&);
+	typedef void (*void3opN)(DynMontFpT*, const DynMontFpT*, const DynMontFpT*, size_t);
+	typedef void (*void2opN)(DynMontFpT*, const DynMontFpT*, size_t);
+	typedef void (*void3opI)(DynMontFpT&, const DynMontFpT&, uint64_t);
+public:
+	/*
+		InvPre : preInv and invTbl_ (default, running time depends on x)
+		InvSafeGcd : constant time safegcd of maxN limbs
+	*/
+	enum { InvPre, InvSafeGcd };
+	static inline void setInvMode(int mode) { invMode_ = mode; }
+	static inline int getInvMode() { return invMode_; }
+	typedef uint64_t BlockType;
+	DynMontFpT() {}
+	DynMontFpT(int x) { operator=(x); }
+	DynMontFpT(uint64_t x) { operator=(x); }
+	explicit DynMontFpT(const std::string& str, int base = 0)
+	{
+		fromStr(str, base);
+	}
+	DynMontFpT& operator=(int x)
+	{
+		*this = uint64_t(x < 0 ? -int64_t(x) : x);
+		if (x < 0) neg(*this, *this);
+		return *this;
+	}
+	DynMontFpT& operator=(uint64_t x)
+	{
+		clear();
+		v_[0] = x;
+		mul(*this, *this, RR_);
+		return *this;
+	}
+	void fromStr(const std::string& str, int base = 0)
+	{
+		bool isMinus;
+		const char *p = fp::verifyStr(&isMinus, &base, str);
+		if (base == 16 || base == 10) {
+			DynMontFpT t;
+			t.clear();
+			const size_t len = str.size() - (p - str.c_str());
+			if (base == 16) {
+				fp::fromStr16(t.v_, N_, p, len);
+			} else {
+				fp::fromStr10(t.v_, N_, p, len);
+			}
+			if (compare(t, p_) >= 0) throw cybozu::Exception("fp:DynMontFpT:str is too large") << str;
+			mul(*this, t, RR_);
+		} else {
+			mpz_class t;
+			if (!Gmp::fromStr(t, p, base)) {
+				throw cybozu::Exception("fp:DynMontFpT:fromStr") << str;
+			}
+			toMont(*this, t);
+		}
+		if (isMinus) neg(*this, *this);
+	}
+	void set(const std::string& str, int base = 0) { fromStr(str, base); }
+	void toStr(std::string& str, int base = 10, bool withPrefix = false) const
+	{
+		if (isZero()) {
+			str = "0";
+			return;
+		}
+		DynMontFpT t;
+		mul(t, *this, one_);
+		switch (base) {
+		case 10:
+			fp::toStr10<maxN>(str, t.v_, N_);
+			break;
+		case 16:
+			fp::toStr16(str, t.v_, N_, withPrefix);
+			break;
+		case 2:
+			fp::toStr2(str, t.v_, N_, withPrefix);
+			break;
+		default:
+			throw cybozu::Exception("fp:DynMontFpT:toStr:bad base") << base;
+		}
+	}
+	std::string toStr(int base = 10, bool withPrefix = false) const
+	{
+		std::string str;
+		toStr(str, base, withPrefix);
+		return str;
+	}
+	static inline size_t getByteSize() { return (modBitLen_ + 7) / 8; }
+	/*
+		same format as MontFpT::serialize
+	*/
+	size_t serialize(void *buf, size_t maxBufSize, bool isMont = false) const
+	{
+		const size_t byteSize = getByteSize();
+		if (maxBufSize < byteSize) throw cybozu::Exception("fp:DynMontFpT:serialize:small buffer") << maxBufSize << byteSize;
+		if (isMont) {
+			fp::copyToLE(buf, byteSize, v_, N_);
+		} else {
+			DynMontFpT t;
+			mul(t, *this, one_);
+			fp::copyToLE(buf, byteSize, t.v_, N_);
+		}
+		return byteSize;
+	}
+	size_t deserialize(const void *buf, size_t bufSize, bool isMont = false)
+	{
+		const size_t byteSize = getByteSize();
+		if (bufSize < byteSize) throw cybozu::Exception("fp:DynMontFpT:deserialize:small buffer") << bufSize << byteSize;
+		DynMontFpT t;
+		t.clear();
+		fp::copyFromLE(t.v_, N_, buf, byteSize);
+		if (compare(t, p_) >= 0) throw cybozu::Exception("fp:DynMontFpT:deserialize:too large");
+		if (isMont) {
+			*this = t;
+		} else {
+			mul(*this, t, RR_);
+		}
+		return byteSize;
+	}
+	void clear()
+	{
+		for (size_t i = 0; i < maxN; i++) v_[i] = 0;
+	}
+	/*
+		N is the number of 64-bit limbs of p
+	*/
+	static inline void setModulo(const std::string& pstr, int base = 0)
+	{
+		bool isMinus;
+		const char *p = fp::verifyStr(&isMinus, &base, pstr);
+		if (isMinus) throw cybozu::Exception("DynMontFpT:setModulo:mstr is not pinus") << pstr;
+		if (!Gmp::fromStr(pOrg_, p, base)) {
+			throw cybozu::Exception("fp:DynMontFpT:setModulo") << pstr << base;
+		}
+		const size_t bitLen = Gmp::getBitLen(pOrg_);
+		const size_t n = fp::getRoundNum(bitLen, 64);
+		if (n < 2 || n > maxN) {
+			throw cybozu::Exception("DynMontFpT:setModulo:bad prime length") << pstr;
+		}
+		modBitLen_ = bitLen;
+		N_ = n;
+		p_.fromRawGmp(pOrg_);
+		fg_.init(p_.v_, int(N_), int(maxN));
+		mpz_class t = 1;
+		one_.fromRawGmp(t);
+		t = (t << (N_ * 64)) % pOrg_;
+		R_.fromRawGmp(t);
+		t = (t * t) % pOrg_;
+		RR_.fromRawGmp(t);
+		add = Xbyak::CastTo<void3op>(fg_.add_);
+		sub = Xbyak::CastTo<void3op>(fg_.sub_);
+		mul = Xbyak::CastTo<void3op>(fg_.mul_);
+		sqr = Xbyak::CastTo<void2op>(fg_.sqr_);
+		neg = Xbyak::CastTo<void2op>(fg_.neg_);
+		preInv = Xbyak::CastTo<int2op>(fg_.preInv_);
+		addVec = Xbyak::CastTo<void3opN>(fg_.addVec_);
+		subVec = Xbyak::CastTo<void3opN>(fg_.subVec_);
+		negVec = Xbyak::CastTo<void2opN>(fg_.negVec_);
+		mulLoop = Xbyak::CastTo<void3opN>(fg_.mulVec_);
+		mulSimd = Xbyak::CastTo<void3opN>(fg_.mulSimd_);
+		mulBy2 = Xbyak::CastTo<void2op>(fg_.mulBy2_);
+		mulBy3 = Xbyak::CastTo<void2op>(fg_.mulBy3_);
+		mulBy4 = Xbyak::CastTo<void2op>(fg_.mulBy4_);
+		mulBy8 = Xbyak::CastTo<void2op>(fg_.mulBy8_);
+		sub2 = Xbyak::CastTo<void3op>(fg_.sub2_);
+		mulUnit = Xbyak::CastTo<void3opI>(fg_.mulUnit_);
+		initInvTbl(invTbl_);
+		modInv_.init(p_.v_, modBitLen_, RR_.v_);
+	}
+	/*
+		use the AVX-512 IFMA kernel in mulVec if the cpu has it
+		call before setModulo (off by default)
+	*/
+	static inline void setUseIfmaSimd(bool useIfmaSimd)
+	{
+		fg_.useIfmaSimd_ = useIfmaSimd;
+	}
+	static inline void getModulo(std::string& pstr)
+	{
+		Gmp::toStr(pstr, pOrg_);
+	}
+	static inline size_t getModBitLen() { return modBitLen_; }
+	/*
+		the number of limbs selected by setModulo
+	*/
+	static inline size_t getLimbN() { return N_; }
+	static inline void fromMont(mpz_class& z, const DynMontFpT& x)
+	{
+		DynMontFpT t;
+		mul(t, x, one_);
+		Gmp::setRaw(z, t.v_, N_);
+	}
+	static inline void toMont(DynMontFpT& z, const mpz_class& x)
+	{
+		if (x >= pOrg_) throw cybozu::Exception("fp:DynMontFpT:toMont:large x") << x;
+		DynMontFpT t;
+		t.fromRawGmp(x);
+		mul(z, t, RR_);
+	}
+	static void3op add;
+	static void3op sub;
+	static void3op mul;
+	static void2op sqr;
+	static void2op neg;
+	static int2op preInv;
+	/*
+		z[i] = x[i] op y[i] for i < n (z may be x or y)
+	*/
+	static void3opN addVec;
+	static void3opN subVec;
+	static void2opN negVec;
+	static void3opN mulLoop;
+	static void3opN mulSimd;
+	// see MontFpT
+	static void2op mulBy2;
+	static void2op mulBy3;
+	static void2op mulBy4;
+	static void2op mulBy8;
+	static void3op sub2;
+	static void3opI mulUnit;
+	static inline void square(DynMontFpT& z, const DynMontFpT& x)
+	{
+		sqr(z, x);
+	}
+	static inline void mulVec(DynMontFpT *z, const DynMontFpT *x, const DynMontFpT *y, size_t n)
+	{
+		size_t done = 0;
+		if (mulSimd) {
+			done = n - n % fg_.simdN_;
+			if (done) mulSimd(z, x, y, done);
+		}
+		mulLoop(z + done, x + done, y + done, n - done);
+	}
+	static inline void inv(DynMontFpT& z, const DynMontFpT& x)
+	{
+		if (invMode_ == InvSafeGcd) {
+			// modInv_ reads maxN limbs
+			DynMontFpT t;
+			t.clear();
+			for (size_t i = 0; i < N_; i++) t.v_[i] = x.v_[i];
+			modInv_.inv(z.v_, t.v_);
+			return;
+		}
+		DynMontFpT r;
+		const int k = preInv(r, x);
+		mul(z, r, invTbl_[k]);
+	}
+	static inline void invVec(DynMontFpT *y, const DynMontFpT *x, size_t n)
+	{
+		fp::invVec(y, x, n);
+	}
+	static inline void div(DynMontFpT& z, const DynMontFpT& x, const DynMontFpT& y)
+	{
+		DynMontFpT ry;
+		inv(ry, y);
+		mul(z, x, ry);
+	}
+	static inline int compare(const DynMontFpT& x, const DynMontFpT& y)
+	{
+		for (size_t i = N_; i > 0; i--) {
+			const uint64_t a = x.v_[i - 1];
+			const uint64_t b = y.v_[i - 1];
+			if (a > b) return 1;
+			if (a < b) return -1;
+		}
+		return 0;
+	}
+	static inline bool isZero(const DynMontFpT& x)
+	{
+		uint64_t r = 0;
+		for (size_t i = 0; i < N_; i++) r |= x.v_[i];
+		return r == 0;
+	}
+	bool isZero() const { return isZero(*this); }
+	template<class Z>
+	static void power(DynMontFpT& z, const DynMontFpT& x, const Z& y)
+	{
+		power_impl::powerWindow(z, x, y);
+	}
+	/*
+		getLimbN() limbs are valid
+	*/
+	const uint64_t* getInnerValue() const { return v_; }
+	bool operator==(const DynMontFpT& rhs) const { return compare(*this, rhs) == 0; }
+	bool operator!=(const DynMontFpT& rhs) const { return compare(*this, rhs) != 0; }
+};
+
+template<class tag>mpz_class DynMontFpT<tag>::pOrg_;
+template<class tag>DynMontFpT<tag> DynMontFpT<tag>::p_;
+template<class tag>DynMontFpT<tag> DynMontFpT<tag>::one_;
+template<class tag>DynMontFpT<tag> DynMontFpT<tag>::R_;
+template<class tag>DynMontFpT<tag> DynMontFpT<tag>::RR_;
+template<class tag>DynMontFpT<tag> DynMontFpT<tag>::invTbl_[DynMontFpT<tag>::maxN * 64 * 2];
+template<class tag>safegcd::ModInv<DynMontFpT<tag>::maxN> DynMontFpT<tag>::modInv_;
+template<class tag>int DynMontFpT<tag>::invMode_ = DynMontFpT<tag>::InvPre;
+template<class tag>size_t DynMontFpT<tag>::N_;
+template<class tag>size_t DynMontFpT<tag>::modBitLen_;
+template<class tag>FpGenerator DynMontFpT<tag>::fg_(4096 * 16);
+
+template<class tag>typename DynMontFpT<tag>::void3op DynMontFpT<tag>::add;
+template<class tag>typename DynMontFpT<tag>::void3op DynMontFpT<tag>::sub;
+template<class tag>typename DynMontFpT<tag>::void3op DynMontFpT<tag>::mul;
+template<class tag>typename DynMontFpT<tag>::void2op DynMontFpT<tag>::sqr;
+template<class tag>typename DynMontFpT<tag>::void2op DynMontFpT<tag>::neg;
+template<class tag>typename DynMontFpT<tag>::int2op DynMontFpT<tag>::preInv;
+template<class tag>typename DynMontFpT<tag>::void3opN DynMontFpT<tag>::addVec;
+template<class tag>typename DynMontFpT<tag>::void3opN DynMontFpT<tag>::subVec;
+template<class tag>typename DynMontFpT<tag>::void2opN DynMontFpT<tag>::negVec;
+template<class tag>typename DynMontFpT<tag>::void3opN DynMontFpT<tag>::mulLoop;
+template<class tag>typename DynMontFpT<tag>::void3opN DynMontFpT<tag>::mulSimd;
+template<class tag>typename DynMontFpT<tag>::void2op DynMontFpT<tag>::mulBy2;
+template<class tag>typename DynMontFpT<tag>::void2op DynMontFpT<tag>::mulBy3;
+template<class tag>typename DynMontFpT<tag>::void2op DynMontFpT<tag>::mulBy4;
+template<class tag>typename DynMontFpT<tag>::void2op DynMontFpT<tag>::mulBy8;
+template<class tag>typename DynMontFpT<tag>::void3op DynMontFpT<tag>::sub2;
+template<class tag>typename DynMontFpT<tag>::void3opI DynMontFpT<tag>::mulUnit;
+
+template<size_t N, class tag>
+struct TagField<MontFpT<N, tag> > {
+	typedef MontFpT<N, tag> F;
+	static void mulBy2(F& z, const F& x) { F::mulBy2(z, x); }
+	static void mulBy3(F& z, const F& x) { F::mulBy3(z, x); }
+	static void mulBy4(F& z, const F& x) { F::mulBy4(z, x); }
+	static void mulBy8(F& z, const F& x) { F::mulBy8(z, x); }
+	static void sub2(F& z, const F& x, const F& y) { F::sub2(z, x, y); }
+};
+
+template<class tag>
+struct TagField<DynMontFpT<tag> > {
+	typedef DynMontFpT<tag> F;
+	static void mulBy2(F& z, const F& x) { F::mulBy2(z, x); }
+	static void mulBy3(F& z, const F& x) { F::mulBy3(z, x); }
+	static void mulBy4(F& z, const F& x) { F::mulBy4(z, x); }
+	static void mulBy8(F& z, const F& x) { F::mulBy8(z, x); }
+	static void sub2(F& z, const F& x, const F& y) { F::sub2(z, x, y); }
+};
+
+typedef DynMontFpT<> DynMontFp;
 
 } // mie
 
@@ -396,4 +1477,12 @@ struct hash<mie::MontFpT<N, tag> > : public std::unary_function<mie::MontFpT<N,
 	}
 };
 
+template<class tag>
+struct hash<mie::DynMontFpT<tag> > : public std::unary_function<mie::DynMontFpT<tag>, size_t> {
+	size_t operator()(const mie::DynMontFpT<tag>& x, uint64_t v = 0) const
+	{
+		return static_cast<size_t>(cybozu::hash64(x.getInnerValue(), mie::DynMontFpT<tag>::getLimbN(), v));
+	}
+};
+
 CYBOZU_NAMESPACE_TR1_END } // std::tr1
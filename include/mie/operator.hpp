@@ -107,6 +107,7 @@ struct Optimized {
 	void init(const T&) {}
 	static void mulMod(T&, const T&, const T&) {}
 	static void mulMod(T&, const T&, unsigned int) {}
+	static void squareMod(T&, const T&) {}
 };
 
 } } // mie::ope
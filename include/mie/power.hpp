@@ -7,6 +7,7 @@
 	http://opensource.org/licenses/BSD-3-Clause
 */
 #include <assert.h>
+#include <vector>
 #include <cybozu/bit_operation.hpp>
 #include <mie/tagmultigr.hpp>
 
@@ -122,5 +123,258 @@ void power(G& z, const G& x, const F& _y)
 	}
 }
 
+template<class F>
+bool getBit(const F& y, size_t i)
+{
+	typedef TagInt<F> TagI;
+	typedef typename TagI::BlockType BlockType;
+	const size_t unitBitN = sizeof(BlockType) * 8;
+	const size_t q = i / unitBitN;
+	if (q >= size_t(TagI::getBlockSize(y))) return false;
+	return ((TagI::getBlock(y, q) >> (i % unitBitN)) & 1) != 0;
+}
+
+/*
+	bit length of y >= 0 (0 if y = 0)
+*/
+template<class F>
+size_t getBitLen(const F& y)
+{
+	typedef TagInt<F> TagI;
+	typedef typename TagI::BlockType BlockType;
+	size_t bitLen = size_t(TagI::getBlockSize(y)) * sizeof(BlockType) * 8;
+	while (bitLen > 0 && !getBit(y, bitLen - 1)) bitLen--;
+	return bitLen;
+}
+
+/*
+	window size of the width-w NAF for a scalar of bitLen bits (2 <= w <= maxNafW)
+*/
+static const size_t maxNafW = 5;
+inline size_t getNafWindowSize(size_t bitLen)
+{
+	return bitLen < 16 ? 2 : bitLen < 96 ? 3 : bitLen < 320 ? 4 : 5;
+}
+
+/*
+	width-w NAF of y >= 0
+	y = sum_i naf[i] 2^i where naf[i] = 0 or odd with |naf[i]| < 2^(w-1)
+	and at most one of any w consecutive digits is not zero
+	naf : buffer of getBitLen(y) + 1 digits
+	return the number of digits n (0 if y = 0) and naf[n - 1] != 0
+*/
+template<class F>
+size_t getNaf(int *naf, const F& y, size_t w)
+{
+	assert(2 <= w && w <= 8);
+	const size_t bitLen = getBitLen(y);
+	for (size_t i = 0; i <= bitLen; i++) naf[i] = 0;
+	const int mask = (1 << w) - 1;
+	const int half = 1 << (w - 1);
+	int c = 0; // carry
+	size_t i = 0;
+	while (i < bitLen || c) {
+		const int b = (getBit(y, i) ? 1 : 0) + c;
+		if (b != 1) {
+			c = b >> 1;
+			i++;
+			continue;
+		}
+		int v = c;
+		for (size_t j = 0; j < w; j++) {
+			if (getBit(y, i + j)) v += 1 << j;
+		}
+		v &= mask;
+		if (v >= half) {
+			v -= 1 << w;
+			c = 1;
+		} else {
+			c = 0;
+		}
+		naf[i] = v;
+		i += w;
+	}
+	size_t n = bitLen + 1;
+	while (n > 0 && naf[n - 1] == 0) n--;
+	return n;
+}
+
+/*
+	window size of the sliding window method for an exponent of bitLen bits
+*/
+inline size_t getWindowSize(size_t bitLen)
+{
+	return bitLen < 64 ? 3 : bitLen < 256 ? 4 : bitLen < 768 ? 5 : 6;
+}
+
+/*
+	sliding window recoding of a fixed exponent e
+	x^e = ((x^d[0])^(2^s[1]) x^d[1])^(2^s[2]) x^d[2] ... )^(2^tail)
+	with odd d[i] < 2^w, so power() needs about bitLen squarings
+	and bitLen / (w + 1) multiplications
+	the sequence of operations depends only on e
+*/
+class FixedExp {
+	struct Digit {
+		uint32_t sqrN; // squarings before the multiplication
+		uint32_t idx; // multiply x^(2 * idx + 1)
+	};
+	std::vector<Digit> v_;
+	size_t w_;
+	size_t tblN_;
+	size_t tailSqrN_;
+	static const size_t maxW = 6;
+	static bool getBit(const uint64_t *e, size_t i)
+	{
+		return ((e[i / 64] >> (i % 64)) & 1) != 0;
+	}
+public:
+	FixedExp() : w_(1), tblN_(0), tailSqrN_(0) {}
+	/*
+		e : n limbs of the exponent
+		w : window size (0 : choose by the bit length of e)
+	*/
+	void init(const uint64_t *e, size_t n, size_t w = 0)
+	{
+		v_.clear();
+		tblN_ = 0;
+		tailSqrN_ = 0;
+		size_t bitLen = n * 64;
+		while (bitLen > 0 && !getBit(e, bitLen - 1)) bitLen--;
+		if (w == 0) w = getWindowSize(bitLen);
+		assert(w <= maxW);
+		w_ = w;
+		size_t zeroN = 0;
+		size_t i = bitLen;
+		while (i > 0) {
+			i--;
+			if (!getBit(e, i)) {
+				zeroN++;
+				continue;
+			}
+			size_t j = i + 1 >= w ? i + 1 - w : 0;
+			while (!getBit(e, j)) j++;
+			uint32_t d = 0;
+			for (size_t k = i + 1; k > j; k--) {
+				d = d * 2 + (getBit(e, k - 1) ? 1 : 0);
+			}
+			Digit dg;
+			dg.sqrN = uint32_t(zeroN + i - j + 1);
+			dg.idx = d >> 1;
+			v_.push_back(dg);
+			if (dg.idx + 1 > tblN_) tblN_ = dg.idx + 1;
+			zeroN = 0;
+			i = j;
+		}
+		tailSqrN_ = zeroN;
+	}
+	size_t getMulNum() const { return v_.empty() ? 0 : v_.size() - 1 + tblN_; }
+	size_t getSqrNum() const
+	{
+		size_t n = tailSqrN_ + (tblN_ > 1 ? 1 : 0);
+		for (size_t i = 1; i < v_.size(); i++) n += v_[i].sqrN;
+		return n;
+	}
+	/*
+		z = x^e (z may be x)
+	*/
+	template<class G>
+	void power(G& z, const G& x) const
+	{
+		typedef TagMultiGr<G> TagG;
+		if (v_.empty()) {
+			TagG::init(z);
+			return;
+		}
+		G tbl[1 << (maxW - 1)]; // tbl[i] = x^(2i + 1)
+		tbl[0] = x;
+		if (tblN_ > 1) {
+			G x2;
+			TagG::square(x2, x);
+			for (size_t i = 1; i < tblN_; i++) {
+				TagG::mul(tbl[i], tbl[i - 1], x2);
+			}
+		}
+		G t = tbl[v_[0].idx];
+		for (size_t i = 1; i < v_.size(); i++) {
+			for (uint32_t j = 0; j < v_[i].sqrN; j++) {
+				TagG::square(t, t);
+			}
+			TagG::mul(t, t, tbl[v_[i].idx]);
+		}
+		for (size_t j = 0; j < tailSqrN_; j++) {
+			TagG::square(t, t);
+		}
+		z = t;
+	}
+};
+
+/*
+	z = x^y by the sliding window method with the recoding of FixedExp
+	for an exponent y known only at run time
+	about bitLen squarings and bitLen / (w + 1) + 2^(w - 1) multiplications
+	op has square, mul, inv and init as TagMultiGr<G>, so that a group
+	whose operations are members of a context object can be used
+*/
+template<class G, class F, class Op>
+void powerWindow(G& z, const G& x, const F& _y, const Op& op)
+{
+	const bool isNegative = _y < 0;
+	const F& y = isNegative ? -_y : _y;
+	const size_t bitLen = getBitLen(y);
+	if (bitLen == 0) {
+		op.init(z);
+		return;
+	}
+	size_t w = getWindowSize(bitLen);
+	if (w > bitLen) w = bitLen;
+	G tbl[1 << 5]; // tbl[i] = x^(2i + 1) for i < 2^(w - 1) ; w <= 6
+	tbl[0] = x;
+	if (w > 1) {
+		G x2;
+		op.square(x2, x);
+		for (size_t i = 1, n = size_t(1) << (w - 1); i < n; i++) {
+			op.mul(tbl[i], tbl[i - 1], x2);
+		}
+	}
+	G t;
+	bool isFirst = true;
+	size_t i = bitLen;
+	while (i > 0) {
+		i--;
+		if (!getBit(y, i)) {
+			op.square(t, t);
+			continue;
+		}
+		// the digit of bits [j, i] is odd and less than 2^w
+		size_t j = i + 1 >= w ? i + 1 - w : 0;
+		while (!getBit(y, j)) j++;
+		size_t d = 0;
+		for (size_t k = i + 1; k > j; k--) {
+			d = d * 2 + (getBit(y, k - 1) ? 1 : 0);
+		}
+		if (isFirst) {
+			t = tbl[d >> 1];
+			isFirst = false;
+		} else {
+			for (size_t k = j; k <= i; k++) {
+				op.square(t, t);
+			}
+			op.mul(t, t, tbl[d >> 1]);
+		}
+		i = j;
+	}
+	z = t;
+	if (isNegative) {
+		op.inv(z, z);
+	}
+}
+
+template<class G, class F>
+void powerWindow(G& z, const G& x, const F& y)
+{
+	powerWindow(z, x, y, TagMultiGr<G>());
+}
+
 } } // mie::power_impl
 
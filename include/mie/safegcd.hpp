@@ -0,0 +1,287 @@
+#pragma once
+/**
+	@file
+	@brief constant time modular inversion by safegcd
+	@author MITSUNARI Shigeo(@herumi)
+	@license modified new BSD license
+	http://opensource.org/licenses/BSD-3-Clause
+
+	D. J. Bernstein and B.-Y. Yang, Fast constant-time gcd computation and modular inversion
+	https://gcd.cr.yp.to/
+*/
+#include <stdint.h>
+#include <stddef.h>
+#if !defined(__SIZEOF_INT128__) && defined(_MSC_VER) && defined(_M_X64)
+	#include <intrin.h>
+#endif
+
+namespace mie {
+
+namespace safegcd {
+
+#ifdef __SIZEOF_INT128__
+typedef __int128 int128;
+inline int128 mul(int64_t a, int64_t b) { return int128(a) * b; }
+inline uint64_t low(int128 x) { return uint64_t(x); }
+#else
+/*
+	signed 128-bit integer for compilers without __int128 (MSVC)
+	only the operations used by ModInv
+*/
+struct int128 {
+	uint64_t L;
+	int64_t H;
+	int128& operator+=(const int128& rhs)
+	{
+		L += rhs.L;
+		H += rhs.H + (L < rhs.L ? 1 : 0);
+		return *this;
+	}
+	int128 operator+(const int128& rhs) const
+	{
+		int128 z = *this;
+		return z += rhs;
+	}
+	// arithmetic shift for 0 < s < 64
+	int128& operator>>=(int s)
+	{
+		L = (L >> s) | (uint64_t(H) << (64 - s));
+		H >>= s;
+		return *this;
+	}
+};
+inline int128 mul(int64_t a, int64_t b)
+{
+	int128 z;
+#if defined(_MSC_VER) && defined(_M_X64)
+	z.L = uint64_t(_mul128(a, b, &z.H));
+#else
+	const uint64_t M32 = 0xffffffff;
+	const uint64_t ua = uint64_t(a), ub = uint64_t(b);
+	const uint64_t a0 = ua & M32, a1 = ua >> 32;
+	const uint64_t b0 = ub & M32, b1 = ub >> 32;
+	const uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0;
+	const uint64_t mid = (p00 >> 32) + (p01 & M32) + (p10 & M32);
+	z.L = (mid << 32) | (p00 & M32);
+	uint64_t H = a1 * b1 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+	// signed correction of the unsigned product
+	H -= (ua >> 63) ? ub : 0;
+	H -= (ub >> 63) ? ua : 0;
+	z.H = int64_t(H);
+#endif
+	return z;
+}
+inline uint64_t low(const int128& x) { return x.L; }
+#endif
+
+/*
+	z = c / x mod p for an odd prime p of N * 64 bits
+	the number of divsteps depends only on the bit length of p,
+	and there is no branch or memory access depending on x
+
+	f, g, d, e are kept as L signed 62-bit limbs
+	(v[i] in [0, 2^62) for i < L - 1 and v[L - 1] has the sign)
+	one batch applies 62 divsteps to the low 64 bits of f and g
+	and then the transition matrix (scaled by 2^62) to f, g and d, e
+	invariant : f = d x / c, g = e x / c mod p
+*/
+template<size_t N>
+class ModInv {
+	static const size_t L = (N * 64 + 2) / 62 + 1;
+	static const uint64_t M62 = uint64_t(-1) >> 2;
+	struct Trans {
+		int64_t u, v, q, r;
+	};
+	int64_t p_[L];
+	int64_t c_[L];
+	uint64_t pInv62_; // p^-1 mod 2^62
+	int batchN_;
+	/*
+		y = x (x is N limbs of unsigned 64-bit)
+	*/
+	static void toS62(int64_t *y, const uint64_t *x)
+	{
+		for (size_t i = 0; i < L; i++) {
+			const size_t pos = i * 62;
+			const size_t q = pos / 64;
+			const size_t r = pos % 64;
+			uint64_t v = 0;
+			if (q < N) {
+				v = x[q] >> r;
+				if (r > 2 && q + 1 < N) v |= x[q + 1] << (64 - r);
+			}
+			y[i] = int64_t(v & M62);
+		}
+	}
+	/*
+		y = x (x must be in [0, 2^(N * 64)))
+	*/
+	static void fromS62(uint64_t *y, const int64_t *x)
+	{
+		for (size_t i = 0; i < N; i++) y[i] = 0;
+		for (size_t i = 0; i < L; i++) {
+			const size_t pos = i * 62;
+			const size_t q = pos / 64;
+			const size_t r = pos % 64;
+			const uint64_t v = uint64_t(x[i]);
+			if (q < N) {
+				y[q] |= v << r;
+				if (r > 2 && q + 1 < N) y[q + 1] |= v >> (64 - r);
+			}
+		}
+	}
+	/*
+		apply 62 divsteps to (delta, f, g) where f is odd
+		divstep(delta, f, g) = (1 - delta, g, (g - f) / 2) if delta > 0 and g is odd
+		                       (1 + delta, f, (g + (g & 1) f) / 2) otherwise
+		only the low 64 bits of f and g are needed
+		t gives 2^62 (f', g') = t (f, g) with |u| + |v|, |q| + |r| <= 2^62
+	*/
+	static int64_t divsteps62(int64_t delta, uint64_t f, uint64_t g, Trans& t)
+	{
+		uint64_t u = 1, v = 0, q = 0, r = 1;
+		uint64_t zeta = 0 - uint64_t(delta); // zeta = -delta
+		for (int i = 0; i < 62; i++) {
+			uint64_t c1 = uint64_t(int64_t(zeta) >> 63); // delta > 0
+			const uint64_t c2 = 0 - (g & 1); // g is odd
+			// g -= f if c1 else g += f, when g is odd
+			g += ((f ^ c1) - c1) & c2;
+			q += ((u ^ c1) - c1) & c2;
+			r += ((v ^ c1) - c1) & c2;
+			c1 &= c2;
+			// swap : f = old g, delta = 1 - delta
+			f += g & c1;
+			u += q & c1;
+			v += r & c1;
+			zeta = (zeta ^ c1) - 1 - c1;
+			g >>= 1;
+			u += u;
+			v += v;
+		}
+		t.u = int64_t(u);
+		t.v = int64_t(v);
+		t.q = int64_t(q);
+		t.r = int64_t(r);
+		return 0 - int64_t(zeta);
+	}
+	/*
+		(f, g) = t (f, g) / 2^62
+	*/
+	static void updateFg(int64_t *f, int64_t *g, const Trans& t)
+	{
+		int128 cf = mul(t.u, f[0]) + mul(t.v, g[0]);
+		int128 cg = mul(t.q, f[0]) + mul(t.r, g[0]);
+		cf >>= 62;
+		cg >>= 62;
+		for (size_t i = 1; i < L; i++) {
+			cf += mul(t.u, f[i]) + mul(t.v, g[i]);
+			cg += mul(t.q, f[i]) + mul(t.r, g[i]);
+			f[i - 1] = int64_t(low(cf) & M62);
+			g[i - 1] = int64_t(low(cg) & M62);
+			cf >>= 62;
+			cg >>= 62;
+		}
+		f[L - 1] = int64_t(low(cf));
+		g[L - 1] = int64_t(low(cg));
+	}
+	/*
+		(d, e) = t (d, e) / 2^62 mod p
+		d, e are in (-2p, p) before and after
+	*/
+	void updateDe(int64_t *d, int64_t *e, const Trans& t) const
+	{
+		const int64_t sd = d[L - 1] >> 63;
+		const int64_t se = e[L - 1] >> 63;
+		// add p for negative d, e so that the result is in (-2p, p)
+		int64_t md = (t.u & sd) + (t.v & se);
+		int64_t me = (t.q & sd) + (t.r & se);
+		int128 cd = mul(t.u, d[0]) + mul(t.v, e[0]);
+		int128 ce = mul(t.q, d[0]) + mul(t.r, e[0]);
+		// choose md, me so that the low 62 bits of t (d, e) + p (md, me) are zero
+		md -= int64_t((pInv62_ * low(cd) + uint64_t(md)) & M62);
+		me -= int64_t((pInv62_ * low(ce) + uint64_t(me)) & M62);
+		cd += mul(p_[0], md);
+		ce += mul(p_[0], me);
+		cd >>= 62;
+		ce >>= 62;
+		for (size_t i = 1; i < L; i++) {
+			cd += mul(t.u, d[i]) + mul(t.v, e[i]) + mul(p_[i], md);
+			ce += mul(t.q, d[i]) + mul(t.r, e[i]) + mul(p_[i], me);
+			d[i - 1] = int64_t(low(cd) & M62);
+			e[i - 1] = int64_t(low(ce) & M62);
+			cd >>= 62;
+			ce >>= 62;
+		}
+		d[L - 1] = int64_t(low(cd));
+		e[L - 1] = int64_t(low(ce));
+	}
+	/*
+		x = x * sign(s) mod p in [0, p) for x in (-2p, p)
+	*/
+	void normalize(int64_t *x, int64_t s) const
+	{
+		int64_t cond = x[L - 1] >> 63;
+		for (size_t i = 0; i < L; i++) x[i] += p_[i] & cond;
+		cond = s >> 63;
+		for (size_t i = 0; i < L; i++) x[i] = (x[i] ^ cond) - cond;
+		for (size_t i = 0; i < L - 1; i++) {
+			x[i + 1] += x[i] >> 62;
+			x[i] &= M62;
+		}
+		cond = x[L - 1] >> 63;
+		for (size_t i = 0; i < L; i++) x[i] += p_[i] & cond;
+		for (size_t i = 0; i < L - 1; i++) {
+			x[i + 1] += x[i] >> 62;
+			x[i] &= M62;
+		}
+	}
+public:
+	/*
+		p : odd prime of bitLen bits
+		c : multiplier of the result in [0, p)
+	*/
+	void init(const uint64_t *p, size_t bitLen, const uint64_t *c)
+	{
+		toS62(p_, p);
+		toS62(c_, c);
+		uint64_t inv = p[0]; // p^-1 mod 2^64 by Newton iteration
+		for (int i = 0; i < 5; i++) inv *= 2 - p[0] * inv;
+		pInv62_ = inv & M62;
+		/*
+			divstep^m(1, f, g) gives (*, +-gcd(f, g), 0) for f^2 + 4g^2 <= 5 * 2^(2d)
+			m >= (49d + 80) / 17 (d < 46), (49d + 57) / 17 (d >= 46)
+			Theorem 11.2 of the paper
+		*/
+		const size_t d = bitLen;
+		const size_t m = (49 * d + (d < 46 ? 80 : 57) + 16) / 17;
+		batchN_ = int((m + 61) / 62);
+	}
+	/*
+		z = c / x mod p (z = 0 if x = 0)
+		x must be in [0, p)
+	*/
+	void inv(uint64_t *z, const uint64_t *x) const
+	{
+		int64_t f[L], g[L], d[L], e[L];
+		for (size_t i = 0; i < L; i++) {
+			f[i] = p_[i];
+			d[i] = 0;
+			e[i] = c_[i];
+		}
+		toS62(g, x);
+		int64_t delta = 1;
+		for (int i = 0; i < batchN_; i++) {
+			Trans t;
+			const uint64_t f0 = uint64_t(f[0]) | (uint64_t(f[1]) << 62);
+			const uint64_t g0 = uint64_t(g[0]) | (uint64_t(g[1]) << 62);
+			delta = divsteps62(delta, f0, g0, t);
+			updateDe(d, e, t);
+			updateFg(f, g, t);
+		}
+		// f = +-1 and c / x = d f
+		normalize(d, f[L - 1]);
+		fromS62(z, d);
+	}
+};
+
+} } // mie::safegcd
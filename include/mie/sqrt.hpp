@@ -0,0 +1,291 @@
+#pragma once
+/**
+	@file
+	@brief square root and Jacobi symbol in Fp
+	@author MITSUNARI Shigeo(@herumi)
+	@license modified new BSD license
+	http://opensource.org/licenses/BSD-3-Clause
+*/
+#include <vector>
+#include <algorithm>
+#include <cybozu/exception.hpp>
+#include <mie/power.hpp>
+
+namespace mie {
+
+namespace fp {
+
+namespace sqrt_local {
+
+template<class T>
+bool isZeroN(const T *x, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		if (x[i]) return false;
+	}
+	return true;
+}
+
+template<class T>
+bool isOneN(const T *x, size_t n)
+{
+	return x[0] == 1 && isZeroN(x + 1, n - 1);
+}
+
+template<class T>
+int compareN(const T *x, const T *y, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		const T a = x[n - 1 - i];
+		const T b = y[n - 1 - i];
+		if (a != b) return a > b ? 1 : -1;
+	}
+	return 0;
+}
+
+// x -= y for x >= y
+template<class T>
+void subN(T *x, const T *y, size_t n)
+{
+	T c = 0;
+	for (size_t i = 0; i < n; i++) {
+		const T a = x[i];
+		const T t = a - y[i];
+		x[i] = t - c;
+		c = (a < y[i] || t < c) ? 1 : 0;
+	}
+}
+
+// x += y for a small y
+template<class T>
+void addN(T *x, T y, size_t n)
+{
+	for (size_t i = 0; i < n && y; i++) {
+		x[i] += y;
+		y = x[i] < y ? 1 : 0;
+	}
+}
+
+// x >>= k
+template<class T>
+void shrN(T *x, size_t n, size_t k)
+{
+	const size_t unitBit = sizeof(T) * 8;
+	const size_t q = k / unitBit;
+	const size_t r = k % unitBit;
+	for (size_t i = 0; i < n; i++) {
+		T v = 0;
+		if (i + q < n) {
+			v = x[i + q] >> r;
+			if (r && i + q + 1 < n) v |= x[i + q + 1] << (unitBit - r);
+		}
+		x[i] = v;
+	}
+}
+
+template<class T>
+size_t getTrailingZeroN(const T *x, size_t n)
+{
+	const size_t unitBit = sizeof(T) * 8;
+	for (size_t i = 0; i < n; i++) {
+		if (x[i] == 0) continue;
+		size_t k = 0;
+		while (((x[i] >> k) & 1) == 0) k++;
+		return i * unitBit + k;
+	}
+	return n * unitBit;
+}
+
+} // sqrt_local
+
+/*
+	Jacobi symbol (a / m) by the binary algorithm (no division)
+	a, m : len limbs, a < m and m is odd
+	a and m are destroyed
+	@note the running time depends on a
+*/
+template<class T>
+int jacobi(T *a, T *m, size_t len)
+{
+	using namespace sqrt_local;
+	int t = 1;
+	for (;;) {
+		if (isZeroN(a, len)) return isOneN(m, len) ? t : 0;
+		const size_t k = getTrailingZeroN(a, len);
+		if (k) {
+			shrN(a, len, k);
+			const int r = int(m[0] & 7);
+			if ((k & 1) && (r == 3 || r == 5)) t = -t;
+		}
+		// a, m are odd
+		if (compareN(a, m, len) < 0) {
+			T *tmp = a; a = m; m = tmp;
+			if ((a[0] & 3) == 3 && (m[0] & 3) == 3) t = -t;
+		}
+		subN(a, m, len);
+	}
+}
+
+/*
+	square root in F, where F is a prime field whose modulus is set
+	the constants are computed by init() from the modulus
+	p = 3 mod 4 : x^((p + 1) / 4)
+	p = 5 mod 8 : Atkin
+	p = 1 mod 8 : Tonelli-Shanks with the table of powers of a non-residue
+*/
+template<class F>
+class SquareRoot {
+	enum {
+		NoSqrt, // p is even or no non-residue is found
+		Mod4_3,
+		Mod8_5,
+		TonelliShanks
+	};
+	int type_;
+	power_impl::FixedExp legendreExp_; // (p - 1) / 2
+	power_impl::FixedExp e_; // (p + 1) / 4, (p - 5) / 8 or (q - 1) / 2
+	size_t s_; // p - 1 = 2^s q for odd q
+	std::vector<F> zTbl_; // zTbl_[i] = z^(q 2^i) for a non-residue z
+public:
+	SquareRoot() : type_(NoSqrt), s_(0) {}
+	/*
+		p : n limbs of the modulus of F
+	*/
+	template<class S>
+	void init(const S *p, size_t n)
+	{
+		using namespace sqrt_local;
+		type_ = NoSqrt;
+		s_ = 0;
+		zTbl_.clear();
+		if (n == 0 || (p[0] & 1) == 0 || isOneN(p, n)) return;
+		// p as 64-bit limbs
+		const size_t unitBit = sizeof(S) * 8;
+		std::vector<uint64_t> pv((n * unitBit + 63) / 64);
+		for (size_t i = 0; i < n; i++) {
+			pv[i * unitBit / 64] |= uint64_t(p[i]) << ((i * unitBit) % 64);
+		}
+		const size_t pn = pv.size();
+		std::vector<uint64_t> e(pv);
+		e[0]--;
+		shrN(&e[0], pn, 1);
+		legendreExp_.init(&e[0], pn);
+		e = pv;
+		switch (pv[0] & 7) {
+		case 3: case 7:
+			e[0] -= 3;
+			shrN(&e[0], pn, 2);
+			addN(&e[0], uint64_t(1), pn);
+			e_.init(&e[0], pn);
+			type_ = Mod4_3;
+			return;
+		case 5:
+			e[0] -= 5;
+			shrN(&e[0], pn, 3);
+			e_.init(&e[0], pn);
+			type_ = Mod8_5;
+			return;
+		default:
+			break;
+		}
+		e[0]--;
+		s_ = getTrailingZeroN(&e[0], pn);
+		shrN(&e[0], pn, s_);
+		power_impl::FixedExp qExp;
+		qExp.init(&e[0], pn);
+		shrN(&e[0], pn, 1);
+		e_.init(&e[0], pn);
+		// the smallest non-residue z with (z / p) = -1
+		std::vector<uint64_t> a(pn), m(pn);
+		int z = 2;
+		for (; z < 1000; z++) {
+			std::fill(a.begin(), a.end(), 0);
+			a[0] = z;
+			m = pv;
+			if (jacobi(&a[0], &m[0], pn) == -1) break;
+		}
+		if (z == 1000) return;
+		zTbl_.resize(s_);
+		qExp.power(zTbl_[0], F(z));
+		for (size_t i = 1; i < s_; i++) {
+			F::square(zTbl_[i], zTbl_[i - 1]);
+		}
+		type_ = TonelliShanks;
+	}
+	/*
+		z = sqrt(x) and return true if x is a square
+		return false otherwise
+	*/
+	bool get(F& z, const F& x) const
+	{
+		if (type_ == NoSqrt) throw cybozu::Exception("fp:SquareRoot:get:not supported");
+		if (x.isZero()) {
+			z.clear();
+			return true;
+		}
+		F r;
+		switch (type_) {
+		case Mod4_3:
+			e_.power(r, x);
+			break;
+		case Mod8_5:
+			{
+				// b = (2x)^((p - 5) / 8), i = 2x b^2 (i^2 = -1 if x is a square), r = x b (i - 1)
+				F t, b, i;
+				F::add(t, x, x);
+				e_.power(b, t);
+				F::square(i, b);
+				F::mul(i, i, t);
+				F::sub(i, i, F(1));
+				F::mul(r, x, b);
+				F::mul(r, r, i);
+			}
+			break;
+		default:
+			{
+				const F one(1);
+				F w, b;
+				e_.power(w, x); // x^((q - 1) / 2)
+				F::mul(r, x, w); // x^((q + 1) / 2)
+				F::mul(b, r, w); // x^q
+				size_t m = s_;
+				while (b != one) {
+					// the smallest i such that b^(2^i) = 1
+					F t = b;
+					size_t i = 0;
+					while (t != one) {
+						F::square(t, t);
+						i++;
+						if (i == m) return false;
+					}
+					F::mul(r, r, zTbl_[s_ - i - 1]);
+					F::mul(b, b, zTbl_[s_ - i]);
+					m = i;
+				}
+				z = r;
+			}
+			return true;
+		}
+		F t;
+		F::square(t, r);
+		if (t != x) return false;
+		z = r;
+		return true;
+	}
+	/*
+		x^((p - 1) / 2)
+		return 1 if x is a square, -1 if not, 0 if x = 0
+	*/
+	int legendre(const F& x) const
+	{
+		if (type_ == NoSqrt) throw cybozu::Exception("fp:SquareRoot:legendre:not supported");
+		F t;
+		legendreExp_.power(t, x);
+		if (t.isZero()) return 0;
+		return t == F(1) ? 1 : -1;
+	}
+};
+
+} // fp
+
+} // mie
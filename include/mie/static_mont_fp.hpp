@@ -0,0 +1,464 @@
+#pragma once
+/**
+	@file
+	@brief Fp with montgomery whose modulus is fixed at compile time
+	@author MITSUNARI Shigeo(@herumi)
+	@license modified new BSD license
+	http://opensource.org/licenses/BSD-3-Clause
+
+	all operations are inline functions by unsigned __int128 (gcc and clang)
+	so that the compiler can inline and schedule them in the caller (e.g. EcT)
+	without FpGenerator and gmp
+*/
+#include <string.h>
+#include <cybozu/exception.hpp>
+#include <cybozu/bit_operation.hpp>
+#include <mie/operator.hpp>
+#include <mie/fp.hpp>
+#include <mie/safegcd.hpp>
+
+namespace mie {
+
+/*
+	Param::N : the number of 64-bit limbs of p
+	Param::getP() : N limbs of an odd prime p (little endian)
+	Param::getR() : R mod p for R = 2^(N * 64)
+	Param::getRR() : R^2 mod p
+	the limbs must be given by the initializer of a static const array
+	so that the compiler can fold them into the code
+*/
+namespace static_param {
+
+struct secp160k1 {
+	enum { N = 3 };
+	static inline const uint64_t *getP()
+	{
+		static const uint64_t p[N] = { 0xfffffffeffffac73ull, 0xffffffffffffffffull, 0x00000000ffffffffull };
+		return p;
+	}
+	static inline const uint64_t *getR()
+	{
+		static const uint64_t R[N] = { 0x0000538d00000000ull, 0x0000000000000001ull, 0x0000000000000000ull };
+		return R;
+	}
+	static inline const uint64_t *getRR()
+	{
+		static const uint64_t RR[N] = { 0x0000000000000000ull, 0x0000a71a1b44bba9ull, 0x0000000000000001ull };
+		return RR;
+	}
+};
+
+struct secp192k1 {
+	enum { N = 3 };
+	static inline const uint64_t *getP()
+	{
+		static const uint64_t p[N] = { 0xfffffffeffffee37ull, 0xffffffffffffffffull, 0xffffffffffffffffull };
+		return p;
+	}
+	static inline const uint64_t *getR()
+	{
+		static const uint64_t R[N] = { 0x00000001000011c9ull, 0x0000000000000000ull, 0x0000000000000000ull };
+		return R;
+	}
+	static inline const uint64_t *getRR()
+	{
+		static const uint64_t RR[N] = { 0x00002392013c4fd1ull, 0x0000000000000001ull, 0x0000000000000000ull };
+		return RR;
+	}
+};
+
+struct secp224k1 {
+	enum { N = 4 };
+	static inline const uint64_t *getP()
+	{
+		static const uint64_t p[N] = { 0xfffffffeffffe56dull, 0xffffffffffffffffull, 0xffffffffffffffffull, 0x00000000ffffffffull };
+		return p;
+	}
+	static inline const uint64_t *getR()
+	{
+		static const uint64_t R[N] = { 0x00001a9300000000ull, 0x0000000000000001ull, 0x0000000000000000ull, 0x0000000000000000ull };
+		return R;
+	}
+	static inline const uint64_t *getRR()
+	{
+		static const uint64_t RR[N] = { 0x0000000000000000ull, 0x0000352602c23069ull, 0x0000000000000001ull, 0x0000000000000000ull };
+		return RR;
+	}
+};
+
+struct secp256k1 {
+	enum { N = 4 };
+	static inline const uint64_t *getP()
+	{
+		static const uint64_t p[N] = { 0xfffffffefffffc2full, 0xffffffffffffffffull, 0xffffffffffffffffull, 0xffffffffffffffffull };
+		return p;
+	}
+	static inline const uint64_t *getR()
+	{
+		static const uint64_t R[N] = { 0x00000001000003d1ull, 0x0000000000000000ull, 0x0000000000000000ull, 0x0000000000000000ull };
+		return R;
+	}
+	static inline const uint64_t *getRR()
+	{
+		static const uint64_t RR[N] = { 0x000007a2000e90a1ull, 0x0000000000000001ull, 0x0000000000000000ull, 0x0000000000000000ull };
+		return RR;
+	}
+};
+
+struct NIST_P192 {
+	enum { N = 3 };
+	static inline const uint64_t *getP()
+	{
+		static const uint64_t p[N] = { 0xffffffffffffffffull, 0xfffffffffffffffeull, 0xffffffffffffffffull };
+		return p;
+	}
+	static inline const uint64_t *getR()
+	{
+		static const uint64_t R[N] = { 0x0000000000000001ull, 0x0000000000000001ull, 0x0000000000000000ull };
+		return R;
+	}
+	static inline const uint64_t *getRR()
+	{
+		static const uint64_t RR[N] = { 0x0000000000000001ull, 0x0000000000000002ull, 0x0000000000000001ull };
+		return RR;
+	}
+};
+
+struct NIST_P224 {
+	enum { N = 4 };
+	static inline const uint64_t *getP()
+	{
+		static const uint64_t p[N] = { 0x0000000000000001ull, 0xffffffff00000000ull, 0xffffffffffffffffull, 0x00000000ffffffffull };
+		return p;
+	}
+	static inline const uint64_t *getR()
+	{
+		static const uint64_t R[N] = { 0xffffffff00000000ull, 0xffffffffffffffffull, 0x0000000000000000ull, 0x0000000000000000ull };
+		return R;
+	}
+	static inline const uint64_t *getRR()
+	{
+		static const uint64_t RR[N] = { 0xffffffff00000001ull, 0xffffffff00000000ull, 0xfffffffe00000000ull, 0x00000000ffffffffull };
+		return RR;
+	}
+};
+
+struct NIST_P256 {
+	enum { N = 4 };
+	static inline const uint64_t *getP()
+	{
+		static const uint64_t p[N] = { 0xffffffffffffffffull, 0x00000000ffffffffull, 0x0000000000000000ull, 0xffffffff00000001ull };
+		return p;
+	}
+	static inline const uint64_t *getR()
+	{
+		static const uint64_t R[N] = { 0x0000000000000001ull, 0xffffffff00000000ull, 0xffffffffffffffffull, 0x00000000fffffffeull };
+		return R;
+	}
+	static inline const uint64_t *getRR()
+	{
+		static const uint64_t RR[N] = { 0x0000000000000003ull, 0xfffffffbffffffffull, 0xfffffffffffffffeull, 0x00000004fffffffdull };
+		return RR;
+	}
+};
+
+} // static_param
+
+/*
+	typedef mie::StaticMontFp<mie::static_param::secp256k1> Fp;
+	x is kept as xR mod p for R = 2^(N * 64)
+*/
+template<class Param, class tag = fp_local::TagDefault>
+class StaticMontFp : public ope::addsub<StaticMontFp<Param, tag>,
+	ope::mulable<StaticMontFp<Param, tag>,
+	ope::invertible<StaticMontFp<Param, tag>,
+	ope::hasNegative<StaticMontFp<Param, tag>,
+	ope::hasIO<StaticMontFp<Param, tag> > > > > > {
+public:
+	static const size_t N = Param::N;
+	static const size_t BlockSize = N;
+	typedef uint64_t BlockType;
+private:
+	typedef unsigned __int128 uint128;
+	uint64_t v_[N];
+	static inline const uint64_t *getP() { return Param::getP(); }
+	static inline const uint64_t *getRR() { return Param::getRR(); }
+	/*
+		-p^-1 mod 2^64 by Newton iteration (folded by the compiler)
+	*/
+	static inline uint64_t getPp()
+	{
+		const uint64_t p0 = getP()[0];
+		uint64_t inv = p0;
+		for (int i = 0; i < 5; i++) inv *= 2 - p0 * inv;
+		return 0 - inv;
+	}
+	/*
+		z = x - p if x >= p else x for x = [c:x] < 2p
+	*/
+	static inline void reduceOnce(uint64_t *z, const uint64_t *x, uint64_t c)
+	{
+		const uint64_t *p = getP();
+		uint64_t t[N];
+		uint64_t b = 0;
+		for (size_t i = 0; i < N; i++) {
+			const uint128 d = uint128(x[i]) - p[i] - b;
+			t[i] = uint64_t(d);
+			b = uint64_t(d >> 64) & 1;
+		}
+		// keep x if c:x < p, that is, c = 0 and b = 1
+		const uint64_t mask = 0 - (b & ~c & 1); // all one if x is kept
+		for (size_t i = 0; i < N; i++) z[i] = (x[i] & mask) | (t[i] & ~mask);
+	}
+	static inline void addMod(uint64_t *z, const uint64_t *x, const uint64_t *y)
+	{
+		uint64_t t[N];
+		uint64_t c = 0;
+		for (size_t i = 0; i < N; i++) {
+			const uint128 s = uint128(x[i]) + y[i] + c;
+			t[i] = uint64_t(s);
+			c = uint64_t(s >> 64);
+		}
+		reduceOnce(z, t, c);
+	}
+	static inline void subMod(uint64_t *z, const uint64_t *x, const uint64_t *y)
+	{
+		const uint64_t *p = getP();
+		uint64_t t[N];
+		uint64_t b = 0;
+		for (size_t i = 0; i < N; i++) {
+			const uint128 d = uint128(x[i]) - y[i] - b;
+			t[i] = uint64_t(d);
+			b = uint64_t(d >> 64) & 1;
+		}
+		const uint64_t mask = 0 - b;
+		uint64_t c = 0;
+		for (size_t i = 0; i < N; i++) {
+			const uint128 s = uint128(t[i]) + (p[i] & mask) + c;
+			z[i] = uint64_t(s);
+			c = uint64_t(s >> 64);
+		}
+	}
+	/*
+		z = xy / R mod p by CIOS
+	*/
+	static inline void mulMont(uint64_t *z, const uint64_t *x, const uint64_t *y)
+	{
+		const uint64_t *p = getP();
+		const uint64_t pp = getPp();
+		uint64_t t[N + 2] = {};
+		for (size_t i = 0; i < N; i++) {
+			uint64_t c = 0;
+			for (size_t j = 0; j < N; j++) {
+				const uint128 v = uint128(x[j]) * y[i] + t[j] + c;
+				t[j] = uint64_t(v);
+				c = uint64_t(v >> 64);
+			}
+			uint128 v = uint128(t[N]) + c;
+			t[N] = uint64_t(v);
+			t[N + 1] = uint64_t(v >> 64);
+			const uint64_t m = t[0] * pp;
+			v = uint128(m) * p[0] + t[0];
+			c = uint64_t(v >> 64);
+			for (size_t j = 1; j < N; j++) {
+				v = uint128(m) * p[j] + t[j] + c;
+				t[j - 1] = uint64_t(v);
+				c = uint64_t(v >> 64);
+			}
+			v = uint128(t[N]) + c;
+			t[N - 1] = uint64_t(v);
+			t[N] = t[N + 1] + uint64_t(v >> 64);
+		}
+		reduceOnce(z, t, t[N]);
+	}
+	static inline void fromMont(uint64_t *z, const uint64_t *x)
+	{
+		const uint64_t one[N] = { 1 };
+		mulMont(z, x, one);
+	}
+public:
+	StaticMontFp() {}
+	StaticMontFp(int x) { operator=(x); }
+	StaticMontFp(uint64_t x) { operator=(x); }
+	explicit StaticMontFp(const std::string& str, int base = 0)
+	{
+		fromStr(str, base);
+	}
+	StaticMontFp& operator=(int x)
+	{
+		*this = uint64_t(x < 0 ? -int64_t(x) : x);
+		if (x < 0) neg(*this, *this);
+		return *this;
+	}
+	StaticMontFp& operator=(uint64_t x)
+	{
+		const uint64_t t[N] = { x };
+		mulMont(v_, t, getRR());
+		return *this;
+	}
+	/*
+		check that pstr is the fixed modulus
+		for the compatibility with MontFpT and FpT
+	*/
+	static inline void setModulo(const std::string& pstr, int base = 0)
+	{
+		bool isMinus;
+		const char *p = fp::verifyStr(&isMinus, &base, pstr);
+		uint64_t t[N];
+		const size_t len = pstr.size() - (p - pstr.c_str());
+		if (base == 16) {
+			fp::fromStr16(t, N, p, len);
+		} else if (base == 10) {
+			fp::fromStr10(t, N, p, len);
+		} else {
+			throw cybozu::Exception("StaticMontFp:setModulo:bad base") << base;
+		}
+		if (isMinus || memcmp(t, getP(), sizeof(t)) != 0) {
+			throw cybozu::Exception("StaticMontFp:setModulo:different modulus") << pstr;
+		}
+	}
+	static inline void getModulo(std::string& pstr)
+	{
+		fp::toStr10<N>(pstr, getP(), N);
+	}
+	static inline size_t getModBitLen()
+	{
+		const uint64_t *p = getP();
+		size_t n = N;
+		while (n > 0 && p[n - 1] == 0) n--;
+		return n == 0 ? 0 : (n - 1) * 64 + cybozu::bsr(p[n - 1]) + 1;
+	}
+	void fromStr(const std::string& str, int base = 0)
+	{
+		bool isMinus;
+		const char *p = fp::verifyStr(&isMinus, &base, str);
+		uint64_t t[N];
+		const size_t len = str.size() - (p - str.c_str());
+		if (base == 16) {
+			fp::fromStr16(t, N, p, len);
+		} else if (base == 10) {
+			fp::fromStr10(t, N, p, len);
+		} else {
+			throw cybozu::Exception("StaticMontFp:fromStr:bad base") << base;
+		}
+		if (compareRaw(t, getP()) >= 0) throw cybozu::Exception("StaticMontFp:fromStr:str is too large") << str;
+		mulMont(v_, t, getRR());
+		if (isMinus) neg(*this, *this);
+	}
+	void set(const std::string& str, int base = 0) { fromStr(str, base); }
+	void toStr(std::string& str, int base = 10, bool withPrefix = false) const
+	{
+		uint64_t t[N];
+		fromMont(t, v_);
+		switch (base) {
+		case 10:
+			fp::toStr10<N>(str, t, N);
+			return;
+		case 16:
+			fp::toStr16(str, t, N, withPrefix);
+			return;
+		case 2:
+			fp::toStr2(str, t, N, withPrefix);
+			return;
+		default:
+			throw cybozu::Exception("StaticMontFp:toStr:bad base") << base;
+		}
+	}
+	std::string toStr(int base = 10, bool withPrefix = false) const
+	{
+		std::string str;
+		toStr(str, base, withPrefix);
+		return str;
+	}
+	/*
+		fixed size of serialize in bytes
+	*/
+	static inline size_t getByteSize() { return (getModBitLen() + 7) / 8; }
+	size_t serialize(void *buf, size_t maxBufSize) const
+	{
+		const size_t byteSize = getByteSize();
+		if (maxBufSize < byteSize) throw cybozu::Exception("StaticMontFp:serialize:small buffer") << maxBufSize << byteSize;
+		uint64_t t[N];
+		fromMont(t, v_);
+		fp::copyToLE(buf, byteSize, t, N);
+		return byteSize;
+	}
+	size_t deserialize(const void *buf, size_t bufSize)
+	{
+		const size_t byteSize = getByteSize();
+		if (bufSize < byteSize) throw cybozu::Exception("StaticMontFp:deserialize:small buffer") << bufSize << byteSize;
+		uint64_t t[N];
+		fp::copyFromLE(t, N, buf, byteSize);
+		if (compareRaw(t, getP()) >= 0) throw cybozu::Exception("StaticMontFp:deserialize:too large");
+		mulMont(v_, t, getRR());
+		return byteSize;
+	}
+	void clear()
+	{
+		for (size_t i = 0; i < N; i++) v_[i] = 0;
+	}
+	static inline void add(StaticMontFp& z, const StaticMontFp& x, const StaticMontFp& y) { addMod(z.v_, x.v_, y.v_); }
+	static inline void sub(StaticMontFp& z, const StaticMontFp& x, const StaticMontFp& y) { subMod(z.v_, x.v_, y.v_); }
+	static inline void mul(StaticMontFp& z, const StaticMontFp& x, const StaticMontFp& y) { mulMont(z.v_, x.v_, y.v_); }
+	static inline void square(StaticMontFp& z, const StaticMontFp& x) { mulMont(z.v_, x.v_, x.v_); }
+	static inline void neg(StaticMontFp& z, const StaticMontFp& x)
+	{
+		const uint64_t zero[N] = {};
+		subMod(z.v_, zero, x.v_);
+	}
+	/*
+		constant time safegcd (z = 0 if x = 0)
+		the setup of ModInv only converts p and R^2, so it is done per call
+		instead of keeping a lazily initialized object
+	*/
+	static inline void inv(StaticMontFp& z, const StaticMontFp& x)
+	{
+		// (xR)^-1 R^2 = x^-1 R
+		safegcd::ModInv<N> modInv;
+		modInv.init(getP(), getModBitLen(), getRR());
+		modInv.inv(z.v_, x.v_);
+	}
+	static inline void invVec(StaticMontFp *y, const StaticMontFp *x, size_t n)
+	{
+		fp::invVec(y, x, n);
+	}
+	static inline void div(StaticMontFp& z, const StaticMontFp& x, const StaticMontFp& y)
+	{
+		StaticMontFp ry;
+		inv(ry, y);
+		mul(z, x, ry);
+	}
+	static inline int compareRaw(const uint64_t *x, const uint64_t *y)
+	{
+		for (size_t i = 0; i < N; i++) {
+			const uint64_t a = x[N - 1 - i];
+			const uint64_t b = y[N - 1 - i];
+			if (a != b) return a > b ? 1 : -1;
+		}
+		return 0;
+	}
+	/*
+		compare the values in Montgomery form (same as MontFpT::compare)
+	*/
+	static inline int compare(const StaticMontFp& x, const StaticMontFp& y)
+	{
+		return compareRaw(x.v_, y.v_);
+	}
+	static inline bool isZero(const StaticMontFp& x)
+	{
+		uint64_t r = 0;
+		for (size_t i = 0; i < N; i++) r |= x.v_[i];
+		return r == 0;
+	}
+	bool isZero() const { return isZero(*this); }
+	template<class Z>
+	static void power(StaticMontFp& z, const StaticMontFp& x, const Z& y)
+	{
+		power_impl::power(z, x, y);
+	}
+	const uint64_t* getInnerValue() const { return v_; }
+	bool operator==(const StaticMontFp& rhs) const { return compare(*this, rhs) == 0; }
+	bool operator!=(const StaticMontFp& rhs) const { return compare(*this, rhs) != 0; }
+};
+
+} // mie
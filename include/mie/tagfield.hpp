@@ -0,0 +1,49 @@
+#pragma once
+/**
+	@file
+	@brief TagField
+	@author MITSUNARI Shigeo(@herumi)
+	@license modified new BSD license
+	http://opensource.org/licenses/BSD-3-Clause
+*/
+
+namespace mie {
+
+/*
+	small multiples in a field used by EcT
+	default tag is by add and sub of F
+	z may be x or y
+*/
+template<class F>
+struct TagField {
+	static void mulBy2(F& z, const F& x)
+	{
+		F::add(z, x, x);
+	}
+	static void mulBy3(F& z, const F& x)
+	{
+		F t;
+		F::add(t, x, x);
+		F::add(z, t, x);
+	}
+	static void mulBy4(F& z, const F& x)
+	{
+		F::add(z, x, x);
+		F::add(z, z, z);
+	}
+	static void mulBy8(F& z, const F& x)
+	{
+		F::add(z, x, x);
+		F::add(z, z, z);
+		F::add(z, z, z);
+	}
+	// z = x - 2y
+	static void sub2(F& z, const F& x, const F& y)
+	{
+		F t;
+		F::add(t, y, y);
+		F::sub(z, x, t);
+	}
+};
+
+} // mie
@@ -6,6 +6,7 @@
 #include <mie/fp.hpp>
 #include <mie/ec.hpp>
 #include <mie/ecparam.hpp>
+#include <mie/fixed_base.hpp>
 #include <time.h>
 
 #if defined(_WIN64) || defined(__x86_64__)
@@ -17,6 +18,12 @@ typedef mie::MontFpT<3> Fp_3;
 typedef mie::MontFpT<4> Fp_4;
 typedef mie::MontFpT<6> Fp_6;
 typedef mie::MontFpT<9> Fp_9;
+#elif defined(USE_FIXED_GMP)
+#include <mie/fixed_gmp.hpp>
+typedef mie::FpT<mie::FixedGmp<3> > Fp_3;
+typedef mie::FpT<mie::FixedGmp<4> > Fp_4;
+typedef mie::FpT<mie::FixedGmp<6> > Fp_6;
+typedef mie::FpT<mie::FixedGmp<9> > Fp_9;
 #else
 typedef mie::FpT<mie::Gmp> Fp_3;
 typedef mie::FpT<mie::Gmp> Fp_4;
@@ -26,6 +33,8 @@ typedef mie::FpT<mie::Gmp> Fp_9;
 
 struct tagZn;
 typedef mie::FpT<mie::Gmp, tagZn> Zn;
+struct tagBig;
+typedef mie::FpT<mie::Gmp, tagBig> Big; // scalars longer than Ec::maxNafBitLen
 
 template<class Fp>
 struct Test {
@@ -114,6 +123,69 @@ struct Test {
 		CYBOZU_TEST_ASSERT(R.isZero());
 	}
 
+	void addMixed() const
+	{
+		Fp x(para.gx);
+		Fp y(para.gy);
+		Ec P(x, y);
+		Ec Q = P + P + P; // not normalized
+		Ec A = P + Q;
+		A.normalize();
+		const Ec tbl[] = { Ec(), P, Q, A, -P, -A, A + A };
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+			for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(tbl); j++) {
+				Ec R = tbl[j];
+				R.normalize();
+				Ec S, T;
+				Ec::add(S, tbl[i], R);
+				Ec::addMixed(T, tbl[i], R);
+				CYBOZU_TEST_EQUAL(S, T);
+				T = tbl[i];
+				Ec::addMixed(T, T, R); // alias
+				CYBOZU_TEST_EQUAL(S, T);
+			}
+		}
+	}
+
+	void normalizeVec() const
+	{
+		Fp x(para.gx);
+		Fp y(para.gy);
+		Ec P(x, y);
+		const size_t n = 20;
+		Ec Q[n], R[n];
+		Ec T = P;
+		for (size_t i = 0; i < n; i++) {
+			if (i % 5 == 1) {
+				Q[i].clear();
+			} else if (i % 5 == 3) {
+				Q[i] = P; // normalized
+			} else {
+				Q[i] = T + P;
+			}
+			R[i] = Q[i];
+			Ec::dbl(T, T);
+		}
+		Fp c[n];
+		Ec::normalizeVec(Q, 0, c);
+		Ec::normalizeVec(Q, n, c);
+		for (size_t i = 0; i < n; i++) {
+			CYBOZU_TEST_EQUAL(Q[i].isZero(), R[i].isZero());
+			CYBOZU_TEST_EQUAL(Q[i], R[i]);
+			if (Q[i].isZero()) continue;
+			R[i].normalize();
+			CYBOZU_TEST_EQUAL(Q[i].x, R[i].x);
+			CYBOZU_TEST_EQUAL(Q[i].y, R[i].y);
+#if MIE_EC_COORD != MIE_EC_USE_AFFINE
+			CYBOZU_TEST_EQUAL(Q[i].z, 1);
+#endif
+		}
+		Ec::normalizeVec(Q, n, c); // nothing to do
+		for (size_t i = 0; i < n; i++) {
+			CYBOZU_TEST_EQUAL(Q[i], R[i]);
+		}
+	}
+
 	void power() const
 	{
 		Fp x(para.gx);
@@ -156,6 +228,170 @@ struct Test {
 		}
 	}
 
+	void power_wnaf() const
+	{
+		Fp x(para.gx);
+		Fp y(para.gy);
+		Ec P(x, y);
+		Ec Q, R;
+		const char *tbl[] = {
+			"0xffff", "0x10000", "12345678", "0x123456789abcdef", "0xfedcba9876543210fedcba987654321",
+		};
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+			const Zn k(tbl[i]);
+			Ec::power(Q, P, k);
+			mie::power_impl::power(R, P, k);
+			CYBOZU_TEST_EQUAL(Q, R);
+		}
+		const Zn n1(-1);
+		for (int i = 0; i < 8; i++) {
+			const Zn k = n1 - i * 1234567;
+			Ec::power(Q, P, k);
+			mie::power_impl::power(R, P, k);
+			CYBOZU_TEST_EQUAL(Q, R);
+			Ec::power(R, P, -k);
+			CYBOZU_TEST_ASSERT((Q + R).isZero());
+		}
+		Ec::power(Q, P, 12345678);
+		mie::power_impl::power(R, P, 12345678);
+		CYBOZU_TEST_EQUAL(Q, R);
+		Ec::power(P, P, 12345678); // alias
+		CYBOZU_TEST_EQUAL(P, R);
+		// k = a^2 + 12345 is too long for the NAF on the stack
+		Big::setModulo("0x7" + std::string(319, 'f')); // 2^1279 - 1
+		const Big a("0x4" + std::string(137, '0')); // 2^550
+		const Big k = a * a + 12345;
+		CYBOZU_TEST_ASSERT(k.getBitLen() > Ec::maxNafBitLen);
+		P.set(x, y);
+		Ec::power(Q, P, k);
+		Ec::power(R, P, a);
+		Ec::power(R, R, a);
+		Ec::power(P, P, 12345);
+		CYBOZU_TEST_EQUAL(Q, R + P);
+	}
+
+	void fixed_base() const
+	{
+		Fp x(para.gx);
+		Fp y(para.gy);
+		Ec P(x, y);
+		mie::EcFixedBaseT<Ec> fb;
+		fb.init(para);
+		Ec Q, R;
+		for (int i = -20; i < 20; i++) {
+			fb.mulGenerator(Q, i);
+			Ec::power(R, P, i);
+			CYBOZU_TEST_EQUAL(Q, R);
+		}
+		const Zn n1(-1);
+		const char *tbl[] = { "0x7f", "0x80", "0x81", "0x123456789abcdef", "0xfedcba9876543210fedcba987654321" };
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+			const Zn k(tbl[i]);
+			fb.mulGenerator(Q, k);
+			Ec::power(R, P, k);
+			CYBOZU_TEST_EQUAL(Q, R);
+			fb.mulGenerator(Q, n1 - k);
+			Ec::power(R, P, n1 - k);
+			CYBOZU_TEST_EQUAL(Q, R);
+		}
+		fb.mulGenerator(Q, n1);
+		CYBOZU_TEST_EQUAL(Q, -P);
+		std::vector<char> buf(fb.getByteSize());
+		CYBOZU_TEST_EQUAL(fb.serialize(&buf[0], buf.size()), buf.size());
+		mie::EcFixedBaseT<Ec> fb2;
+		CYBOZU_TEST_EQUAL(fb2.deserialize(&buf[0], buf.size()), buf.size());
+		CYBOZU_TEST_ASSERT(fb2.isBuilt());
+		const Zn k(tbl[3]);
+		fb2.mulGenerator(Q, k);
+		Ec::power(R, P, k);
+		CYBOZU_TEST_EQUAL(Q, R);
+		CYBOZU_TEST_EXCEPTION(fb2.deserialize(&buf[0], buf.size() - 1), cybozu::Exception);
+		mie::EcFixedBaseT<Ec> fb3;
+		fb3.init(P, 16);
+		CYBOZU_TEST_EXCEPTION(fb3.mulGenerator(Q, 0x10000), cybozu::Exception);
+		fb3.mulGenerator(Q, 0xffff);
+		Ec::power(R, P, 0xffff);
+		CYBOZU_TEST_EQUAL(Q, R);
+	}
+
+	void mulVec() const
+	{
+		Fp x(para.gx);
+		Fp y(para.gy);
+		Ec P(x, y);
+		const size_t maxN = 300;
+		std::vector<Ec> Ps(maxN);
+		std::vector<Zn> ks(maxN);
+		Ec T = P;
+		Zn k("0x123456789abcdef0123456789abcdef");
+		for (size_t i = 0; i < maxN; i++) {
+			Ps[i] = T;
+			ks[i] = k;
+			if (i % 7 == 3) Ps[i].clear();
+			if (i % 5 == 2) ks[i] = -ks[i];
+			if (i % 11 == 4) ks[i] = 0;
+			if (i % 13 == 6) Ps[i] = P; // same points in one bucket
+			T += P;
+			Ec::dbl(T, T);
+			k *= k;
+			k += 12345;
+		}
+		const size_t nTbl[] = { 0, 1, 7, 8, 9, 50, 300 };
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(nTbl); i++) {
+			const size_t n = nTbl[i];
+			Ec Q, R, t;
+			for (size_t j = 0; j < n; j++) {
+				Ec::power(t, Ps[j], ks[j]);
+				R += t;
+			}
+			Ec::mulVec(Q, &Ps[0], &ks[0], n);
+			CYBOZU_TEST_EQUAL(Q, R);
+		}
+		std::vector<int> is(50);
+		Ec R, t;
+		for (size_t i = 0; i < is.size(); i++) {
+			is[i] = int(i * i) - 1000;
+			Ec::power(t, Ps[i], is[i]);
+			R += t;
+		}
+		Ec::mulVec(Ps[0], &Ps[0], &is[0], is.size()); // alias
+		CYBOZU_TEST_EQUAL(Ps[0], R);
+	}
+
+	void serialize() const
+	{
+		Fp x(para.gx);
+		Fp y(para.gy);
+		Ec P(x, y);
+		const size_t n = 4;
+		Ec Q[n], R[n];
+		Q[1] = P;
+		Q[2] = P + P;
+		Q[3] = -P;
+		const size_t byteSize = Ec::getByteSize();
+		CYBOZU_TEST_EQUAL(byteSize, 1 + Fp::getByteSize() * 2);
+		std::vector<char> buf(byteSize * n);
+		for (size_t i = 0; i < n; i++) {
+			CYBOZU_TEST_EQUAL(Q[i].serialize(&buf[0], byteSize), byteSize);
+			CYBOZU_TEST_EQUAL(buf[0], Q[i].isZero() ? 0 : 1);
+			CYBOZU_TEST_EQUAL(R[i].deserialize(&buf[0], byteSize), byteSize);
+			CYBOZU_TEST_EQUAL(Q[i], R[i]);
+		}
+		// not on the curve
+		P.serialize(&buf[0], byteSize);
+		buf[1] ^= 1;
+		CYBOZU_TEST_EXCEPTION(R[0].deserialize(&buf[0], byteSize), cybozu::Exception);
+		buf[1] ^= 1;
+		buf[0] = 4; // SEC1 tag is not accepted
+		CYBOZU_TEST_EXCEPTION(R[0].deserialize(&buf[0], byteSize), cybozu::Exception);
+		CYBOZU_TEST_EQUAL(Ec::serializeVec(&buf[0], buf.size(), Q, n), buf.size());
+		for (size_t i = 0; i < n; i++) R[i].clear();
+		CYBOZU_TEST_EQUAL(Ec::deserializeVec(R, n, &buf[0], buf.size()), buf.size());
+		for (size_t i = 0; i < n; i++) {
+			CYBOZU_TEST_EQUAL(Q[i], R[i]);
+		}
+	}
+
 	template<class F>
 	void test(F f, const char *msg) const
 	{
@@ -188,6 +424,21 @@ struct Test {
 		CYBOZU_BENCH("dbl", Ec::dbl, P, P);
 		Zn z("-3");
 		CYBOZU_BENCH("pow", Ec::power, P, P, z);
+		mie::EcFixedBaseT<Ec> fb;
+		fb.init(para);
+		CYBOZU_BENCH("mulGen", fb.mulGenerator, Q, z);
+		const size_t vecN = 1000;
+		std::vector<Ec> Ps(vecN, P);
+		std::vector<Zn> ks(vecN);
+		for (size_t i = 0; i < vecN; i++) {
+			Ec::dbl(Ps[i], i == 0 ? P : Ps[i - 1]);
+			ks[i] = z - int(i);
+		}
+		CYBOZU_BENCH_C("mulVec(1000)", 10, Ec::mulVec, Q, &Ps[0], &ks[0], vecN);
+		std::vector<Ec> Rs(vecN), Ts(vecN);
+		std::vector<Fp> c(vecN);
+		for (size_t i = 0; i < vecN; i++) Rs[i] = Ps[i] + P;
+		CYBOZU_BENCH_C("normalizeVec(1000)", 10, Ts = Rs; Ec::normalizeVec, &Ts[0], vecN, &c[0]);
 	}
 /*
 Affine : sandy-bridge
@@ -205,9 +456,15 @@ pow 499.00usec
 	{
 		cstr();
 		ope();
+		addMixed();
+		normalizeVec();
 		power();
 		neg_power();
 		power_fp();
+		power_wnaf();
+		fixed_base();
+		mulVec();
+		serialize();
 #ifdef NDEBUG
 		bench();
 #endif
@@ -232,6 +489,8 @@ CYBOZU_TEST_AUTO(all)
 {
 #ifdef USE_MONT_FP
 	puts("use MontFp");
+#elif defined(USE_FIXED_GMP)
+	puts("use FixedGmp");
 #else
 	puts("use GMP");
 #endif
@@ -14,13 +14,19 @@
 
 typedef mie::FpT<mie::Gmp> Fp;
 
-const int MAX_N = 4;
+const int MAX_N = 9;
 
 const char *primeTable[] = {
 	"7fffffffffffffffffffffffffffffff", // 127bit(not full)
 	"ffffffffffffffffffffffffffffff61", // 128bit(full)
 	"fffffffffffffffffffffffffffffffffffffffeffffee37", // 192bit(full)
 	"2523648240000001ba344d80000000086121000000000013a700000000000013", // 254bit(not full)
+	"fffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f", // 256bit(full)
+	"14dd7193bd69fe29d76d4330f1446beab0c11fdecb91ce375bc8fbbcbde5c0994164d8399f767ccd", // 317bit(not full)
+	"1be5bb2f1cfb10f62827688de6a16a3b0d464138a62332553fc1ea36f17fd374c6a5387777330bdbd7210dff076ce2ef87b0b125ec1d7dad", // 445bit(not full)
+	"815c33b2df1461aaf8eb18b90074513021da8978206f5c6671e0c07e9e115e4b9e30691c238642ea126a1e48cc11d357c30d8b7628dbd25e63b229f1c4069583", // 512bit(full)
+	"15d03acd346c6e2ba02fdaa1ad864c44e049548e8a0a8c9632ea6928f6236bf2504b74ba4a0fe75d2a9eba0cdf561d802a759159fb7ff337f5cae3bf3729c619c60a3cab359ef161", // 573bit(not full)
+	"d4f46a6910acff0043892dfc254cb864ef901b932a7c18806a3753915c76f18a0585a01c4c7d6df0621aef57e4cc4132f7108e96f770c2263266aa3bb0cde917f7f35634f0e3cf6b", // 576bit(full)
 };
 
 /*
@@ -195,6 +201,48 @@ void testShr1(const mie::FpGenerator& fg, int pn)
 	}
 }
 
+/*
+	mul_(z, x, y) = mod_(z, mulPre_(x, y)) = x * y / R mod p for R = 2^(64pn)
+*/
+void testMul(const mie::FpGenerator& fg, int pn)
+{
+	cybozu::XorShift rg;
+	mpz_class p, rR = 1;
+	mie::Gmp::setRaw(p, fg.p_, pn);
+	rR <<= pn * 64;
+	mie::Gmp::invMod(rR, rR % p, p);
+	for (int i = 0; i < 100; i++) {
+		uint64_t x[MAX_N], y[MAX_N], z[MAX_N], xy[MAX_N * 2];
+		mpz_class mx, my, mz;
+		rg.read(x, pn);
+		rg.read(y, pn);
+		mie::Gmp::setRaw(mx, x, pn);
+		mie::Gmp::setRaw(my, y, pn);
+		mx %= p;
+		my %= p;
+		if (i == 0) mx = p - 1;
+		if (i == 1) my = p - 1;
+		mie::Gmp::getRaw(x, pn, mx);
+		mie::Gmp::getRaw(y, pn, my);
+		fg.mul_(z, x, y);
+		mie::Gmp::setRaw(mz, z, pn);
+		CYBOZU_TEST_EQUAL(mz, mx * my * rR % p);
+		fg.sqr_(z, x);
+		mie::Gmp::setRaw(mz, z, pn);
+		CYBOZU_TEST_EQUAL(mz, mx * mx * rR % p);
+		fg.mulPre_(xy, x, y);
+		fg.mod_(z, xy);
+		mie::Gmp::setRaw(mz, z, pn);
+		CYBOZU_TEST_EQUAL(mz, mx * my * rR % p);
+	}
+	{
+		uint64_t x[MAX_N];
+		mie::Gmp::getRaw(x, pn, p - 3);
+		CYBOZU_BENCH_C("mul", 10000000, fg.mul_, x, x, x);
+		CYBOZU_BENCH_C("sqr", 10000000, fg.sqr_, x, x);
+	}
+}
+
 void test(const char *pStr)
 {
 	Fp::setModulo(pStr, 16);
@@ -207,6 +255,14 @@ void test(const char *pStr)
 	testNeg(fg, pn);
 	testMulI(fg, pn);
 	testShr1(fg, pn);
+	testMul(fg, pn);
+	// the generic montgomery reduction for a special prime
+	if (fg.isSpecialMod()) {
+		mie::FpGenerator fgMont;
+		fgMont.useSpecialMod_ = false;
+		fgMont.init(p, pn);
+		testMul(fgMont, pn);
+	}
 }
 
 CYBOZU_TEST_AUTO(all)
@@ -216,4 +272,92 @@ CYBOZU_TEST_AUTO(all)
 		test(primeTable[i]);
 	}
 }
+
+/*
+	the largest code (pn = 9 with the stride 12 and every optional kernel)
+	fits the default buffer 4096 * 16 of DynMontFpT
+*/
+CYBOZU_TEST_AUTO(codeSize)
+{
+	const int maxN = 9;
+	uint64_t p[maxN];
+	for (int i = 0; i < maxN; i++) p[i] = uint64_t(-1);
+	p[0] = uint64_t(-189);
+	size_t maxSize = 0;
+	for (int pn = 2; pn <= maxN; pn++) {
+		for (int sp = 0; sp < 2; sp++) {
+			mie::FpGenerator fg;
+			fg.useSpecialMod_ = sp != 0;
+			fg.useIfmaSimd_ = true;
+			fg.init(p + maxN - pn, pn, 12);
+			maxSize = std::max(maxSize, fg.getSize());
+		}
+	}
+	printf("max code size=%d\n", (int)maxSize);
+	CYBOZU_TEST_ASSERT(maxSize <= 4096 * 16);
+}
+
+/*
+	mul_ by adcx/adox (useAdx_) and by the former code give the same value
+	and compare their speed
+*/
+CYBOZU_TEST_AUTO(adx)
+{
+	const char *tbl[] = {
+		"ffffffffffffffffffffffffffffff61", // 128bit(full)
+		"fffffffffffffffffffffffffffffffffffffffeffffee37", // 192bit(full)
+		"2523648240000001ba344d80000000086121000000000013a700000000000013", // 254bit(not full)
+		"fffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f", // 256bit(full)
+		"14dd7193bd69fe29d76d4330f1446beab0c11fdecb91ce375bc8fbbcbde5c0994164d8399f767ccd", // 317bit(not full)
+		"fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffeffffffff0000000000000000ffffffff", // 384bit(full)
+		"1be5bb2f1cfb10f62827688de6a16a3b0d464138a62332553fc1ea36f17fd374c6a5387777330bdbd7210dff076ce2ef87b0b125ec1d7dad", // 445bit(not full)
+		"815c33b2df1461aaf8eb18b90074513021da8978206f5c6671e0c07e9e115e4b9e30691c238642ea126a1e48cc11d357c30d8b7628dbd25e63b229f1c4069583", // 512bit(full)
+		"1ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff", // 521bit(not full)
+	};
+	const int maxN = 9;
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		mpz_class p;
+		p.set_str(tbl[i], 16);
+		uint64_t pa[maxN];
+		const int pn = (int)mie::fp::getRoundNum(mie::Gmp::getBitLen(p), 64);
+		mie::Gmp::getRaw(pa, pn, p);
+		mie::FpGenerator fg, fgOrg;
+		if (!fg.useAdx_) {
+			puts("ADX is not available");
+			return;
+		}
+		fgOrg.useAdx_ = false;
+		fg.init(pa, pn);
+		fgOrg.init(pa, pn);
+		cybozu::XorShift rg;
+		const size_t n = 16;
+		uint64_t x[n][maxN], y[n][maxN], z1[n][maxN], z2[n][maxN];
+		for (size_t j = 0; j < n; j++) {
+			mpz_class mx, my;
+			rg.read(x[j], pn);
+			rg.read(y[j], pn);
+			mie::Gmp::setRaw(mx, x[j], pn);
+			mie::Gmp::setRaw(my, y[j], pn);
+			mx %= p;
+			my %= p;
+			if (j == 0) mx = p - 1;
+			if (j == 1) my = p - 1;
+			mie::Gmp::getRaw(x[j], pn, mx);
+			mie::Gmp::getRaw(y[j], pn, my);
+			fg.mul_(z1[j], x[j], y[j]);
+			fgOrg.mul_(z2[j], x[j], y[j]);
+			for (int k = 0; k < pn; k++) CYBOZU_TEST_EQUAL(z1[j][k], z2[j][k]);
+		}
+		// mulVec_ for the stride maxN
+		mie::FpGenerator fgVec;
+		fgVec.init(pa, pn, maxN);
+		fgVec.mulVec_(z1[0], x[0], y[0], n);
+		for (size_t j = 0; j < n; j++) {
+			for (int k = 0; k < pn; k++) CYBOZU_TEST_EQUAL(z1[j][k], z2[j][k]);
+		}
+		printf("pn=%d isFullBit=%d\n", pn, fg.isFullBit_);
+		CYBOZU_BENCH_C("mul:adx", 10000000, fg.mul_, x[0], x[0], y[0]);
+		CYBOZU_BENCH_C("mul:org", 10000000, fgOrg.mul_, x[0], x[0], y[0]);
+	}
+}
 #endif
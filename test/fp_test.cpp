@@ -2,6 +2,7 @@
 #include <cybozu/test.hpp>
 #include <mie/fp.hpp>
 #include <mie/gmp_util.hpp>
+#include <mie/fixed_gmp.hpp>
 #include <cybozu/benchmark.hpp>
 #include <time.h>
 
@@ -14,6 +15,11 @@ typedef mie::MontFpT<3> Fp3;
 typedef mie::MontFpT<4> Fp4;
 typedef mie::MontFpT<6> Fp6;
 typedef mie::MontFpT<9> Fp9;
+#elif defined(USE_FIXED_GMP)
+typedef mie::FpT<mie::FixedGmp<3> > Fp3;
+typedef mie::FpT<mie::FixedGmp<4> > Fp4;
+typedef mie::FpT<mie::FixedGmp<6> > Fp6;
+typedef mie::FpT<mie::FixedGmp<9> > Fp9;
 #else
 typedef mie::FpT<mie::Gmp> Fp3;
 typedef mie::FpT<mie::Gmp> Fp4;
@@ -32,6 +38,8 @@ struct Init {
 		Fp::setModulo(ms.str());
 #ifdef USE_MONT_FP
 		puts("use MontFp");
+#elif defined(USE_FIXED_GMP)
+		puts("use FixedGmp");
 #else
 		puts("use GMP");
 #endif
@@ -312,6 +320,184 @@ CYBOZU_TEST_AUTO(power_fp)
 	}
 }
 
+CYBOZU_TEST_AUTO(invVec)
+{
+	const int tbl[] = { 3, 0, 5, -1, 0, 0, 12345, 1 };
+	const size_t n = CYBOZU_NUM_OF_ARRAY(tbl);
+	Fp x[n], y[n];
+	for (size_t i = 0; i < n; i++) x[i] = tbl[i];
+	Fp::invVec(y, x, n);
+	for (size_t i = 0; i < n; i++) {
+		if (x[i].isZero()) {
+			CYBOZU_TEST_ASSERT(y[i].isZero());
+		} else {
+			CYBOZU_TEST_EQUAL(y[i], 1 / x[i]);
+		}
+	}
+	Fp::invVec(x, x, n);
+	for (size_t i = 0; i < n; i++) {
+		CYBOZU_TEST_EQUAL(x[i], y[i]);
+	}
+}
+
+CYBOZU_TEST_AUTO(serialize)
+{
+	const int tbl[] = { 0, 1, 255, 256, 12345, m - 1 };
+	const size_t n = CYBOZU_NUM_OF_ARRAY(tbl);
+	const size_t byteSize = Fp::getByteSize();
+	CYBOZU_TEST_EQUAL(byteSize, 3u);
+	Fp x[n], y[n];
+	uint8_t buf[byteSize * n];
+	for (size_t i = 0; i < n; i++) {
+		x[i] = tbl[i];
+		CYBOZU_TEST_EQUAL(x[i].serialize(buf, byteSize), byteSize);
+		CYBOZU_TEST_EQUAL(buf[0] | (buf[1] << 8) | (buf[2] << 16), tbl[i]);
+		CYBOZU_TEST_EQUAL(y[i].deserialize(buf, byteSize), byteSize);
+		CYBOZU_TEST_EQUAL(x[i], y[i]);
+	}
+	CYBOZU_TEST_EXCEPTION(x[0].serialize(buf, byteSize - 1), cybozu::Exception);
+	buf[0] = 1; buf[1] = 0; buf[2] = 1; // m
+	CYBOZU_TEST_EXCEPTION(y[0].deserialize(buf, byteSize), cybozu::Exception);
+	CYBOZU_TEST_EQUAL(Fp::serializeVec(buf, sizeof(buf), x, n), sizeof(buf));
+	for (size_t i = 0; i < n; i++) y[i].clear();
+	CYBOZU_TEST_EQUAL(Fp::deserializeVec(y, n, buf, sizeof(buf)), sizeof(buf));
+	for (size_t i = 0; i < n; i++) {
+		CYBOZU_TEST_EQUAL(x[i], y[i]);
+	}
+	CYBOZU_TEST_EXCEPTION(Fp::serializeVec(buf, sizeof(buf) - 1, x, n), cybozu::Exception);
+}
+
+CYBOZU_TEST_AUTO(specialModulo)
+{
+	const char *pTbl[] = {
+		"0x1ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff", // 2^521 - 1
+		"0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f", // secp256k1
+		"0xffffffffffffffffffffffffffffffff000000000000000000000001", // P224
+		"0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffeffffffff0000000000000000ffffffff", // P384
+		"0xfffffffffffffffffffffffe26f2fc170f69466a74defd8d", // generic
+		"0xffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff", // 2^1100 - 1 (not prime, too large to be optimized)
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(pTbl); i++) {
+		Fp::setModulo(pTbl[i]);
+		const mpz_class m(pTbl[i]);
+		const mpz_class tbl[] = {
+			0, 1, 2, 12345, m - 1, m - 2, m / 2, m / 3, (m * 2) / 3, (mpz_class(1) << (Fp::getModBitLen() / 2)) + 1,
+		};
+		const size_t n = CYBOZU_NUM_OF_ARRAY(tbl);
+		for (size_t j = 0; j < n; j++) {
+			const Fp x(tbl[j].get_str());
+			for (size_t k = 0; k < n; k++) {
+				const Fp y(tbl[k].get_str());
+				CYBOZU_TEST_EQUAL((x * y).getInnerValue(), tbl[j] * tbl[k] % m);
+				if (gcd(tbl[k], m) == 1) {
+					CYBOZU_TEST_EQUAL(x / y * y, x);
+				}
+			}
+			Fp z;
+			Fp::square(z, x);
+			CYBOZU_TEST_EQUAL(z.getInnerValue(), tbl[j] * tbl[j] % m);
+			CYBOZU_TEST_EQUAL((x * 0xffffffffu).getInnerValue(), tbl[j] * 0xffffffffu % m);
+			z = x;
+			z *= z;
+			CYBOZU_TEST_EQUAL(z.getInnerValue(), tbl[j] * tbl[j] % m);
+		}
+	}
+	Fp::setModulo("65537");
+}
+
+struct tagFixed;
+typedef mie::FpT<mie::FixedGmp<4>, tagFixed> FixedFp;
+
+CYBOZU_TEST_AUTO(fixedGmp)
+{
+	const char *pTbl[] = {
+		"65537",
+		"0xfffffffffffffffffffffffe26f2fc170f69466a74defd8d",
+		"0x2523648240000001ba344d80000000086121000000000013a700000000000013",
+		"0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f",
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(pTbl); i++) {
+		Fp::setModulo(pTbl[i]);
+		FixedFp::setModulo(pTbl[i]);
+		CYBOZU_TEST_EQUAL(FixedFp::getModBitLen(), Fp::getModBitLen());
+		const mpz_class m(pTbl[i]);
+		const mpz_class tbl[] = {
+			0, 1, 2, 12345, m - 1, m - 2, m / 2, m / 3, (m * 2) / 3,
+		};
+		const size_t n = CYBOZU_NUM_OF_ARRAY(tbl);
+		for (size_t j = 0; j < n; j++) {
+			for (size_t k = 0; k < n; k++) {
+				const Fp x(tbl[j].get_str()), y(tbl[k].get_str());
+				const FixedFp fx(tbl[j].get_str()), fy(tbl[k].get_str());
+				CYBOZU_TEST_EQUAL(fx.toStr(), x.toStr());
+				CYBOZU_TEST_EQUAL((fx + fy).toStr(), (x + y).toStr());
+				CYBOZU_TEST_EQUAL((fx - fy).toStr(), (x - y).toStr());
+				CYBOZU_TEST_EQUAL((fx * fy).toStr(), (x * y).toStr());
+				CYBOZU_TEST_EQUAL((fx * 12345).toStr(), (x * 12345).toStr());
+				CYBOZU_TEST_EQUAL((fx - 3).toStr(), (x - 3).toStr());
+				CYBOZU_TEST_EQUAL((-fx).toStr(), (-x).toStr());
+				CYBOZU_TEST_EQUAL(fx == fy, x == y);
+				CYBOZU_TEST_EQUAL(fx < fy, x < y);
+				if (!y.isZero()) {
+					CYBOZU_TEST_EQUAL((fx / fy).toStr(), (x / y).toStr());
+				}
+			}
+			FixedFp fz;
+			FixedFp::square(fz, FixedFp(tbl[j].get_str()));
+			Fp z;
+			Fp::square(z, Fp(tbl[j].get_str()));
+			CYBOZU_TEST_EQUAL(fz.toStr(16), z.toStr(16));
+			FixedFp::power(fz, fz, FixedFp(tbl[j].get_str()));
+			Fp::power(z, z, Fp(tbl[j].get_str()));
+			CYBOZU_TEST_EQUAL(fz.toStr(), z.toStr());
+		}
+		CYBOZU_TEST_EQUAL(FixedFp(-5).toStr(), Fp(-5).toStr());
+		CYBOZU_TEST_EXCEPTION(FixedFp(m.get_str()), cybozu::Exception);
+	}
+	Fp::setModulo("65537");
+}
+
+CYBOZU_TEST_AUTO(sqrt)
+{
+	const char *tbl[] = {
+		"13", // 5 mod 8
+		"65537", // 1 mod 8, p - 1 = 2^16
+		"0xfffffffffffffffffffffffe26f2fc170f69466a74defd8d", // 5 mod 8
+		"0xffffffffffffffffffffffffffffffff000000000000000000000001", // 1 mod 2^96
+		"0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f", // 3 mod 4
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		Fp::setModulo(tbl[i]);
+		Fp x, y, z;
+		x = 0;
+		for (int j = 0; j < 100; j++) {
+			const bool isSquare = Fp::sqrt(y, x);
+			CYBOZU_TEST_EQUAL(isSquare, Fp::isSquare(x));
+			CYBOZU_TEST_EQUAL(isSquare, Fp::legendre(x) >= 0);
+			if (isSquare) {
+				CYBOZU_TEST_EQUAL(y * y, x);
+			}
+			Fp::square(z, x);
+			CYBOZU_TEST_ASSERT(Fp::isSquare(z));
+			CYBOZU_TEST_ASSERT(Fp::sqrt(y, z));
+			CYBOZU_TEST_EQUAL(y * y, z);
+			x = x * 5 + 3;
+		}
+	}
+	// m of more than maxJacobiN blocks
+	Fp::setModulo("0x7" + std::string(319, 'f')); // 2^1279 - 1
+	Fp x = 2;
+	for (int j = 0; j < 10; j++) {
+		Fp y;
+		CYBOZU_TEST_EQUAL(Fp::isSquare(x), Fp::sqrt(y, x));
+		CYBOZU_TEST_ASSERT(Fp::isSquare(x * x));
+		x = x * 5 + 3;
+	}
+	std::ostringstream ms;
+	ms << m;
+	Fp::setModulo(ms.str());
+}
+
 struct TagAnother;
 
 CYBOZU_TEST_AUTO(another)
@@ -129,12 +129,19 @@ struct Test {
 		compare();
 		modulo();
 		ope();
+		sqr();
+		vec();
+		smallMul();
+		dbl();
+		inv();
+		fixedExp();
 		power();
 		neg_power();
 		power_Zn();
 		setRaw();
 		set64bit();
 		getRaw();
+		serialize();
 		bench();
 	}
 	void cstr()
@@ -429,6 +436,163 @@ struct Test {
 		}
 	}
 
+	void sqr()
+	{
+		mpz_class t = 1;
+		const mpz_class R = (t << (Fp::BlockSize * 64)) % m;
+		const mpz_class tbl[] = {
+			0, 1, 2, R, R + 1, m - 1, m - 2, m - R, m / 2, (m + 1) / 2
+		};
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+			Fp x, y, z;
+			Fp::toMont(x, tbl[i]);
+			Fp::square(y, x);
+			Fp::mul(z, x, x);
+			CYBOZU_TEST_EQUAL(y, z);
+			mpz_class w;
+			Fp::fromMont(w, y);
+			CYBOZU_TEST_EQUAL(w, (tbl[i] * tbl[i]) % m);
+		}
+		Fp x("-0x123456789abcdef");
+		for (int i = 0; i < 100; i++) {
+			Fp y, z;
+			Fp::square(y, x);
+			Fp::mul(z, x, x);
+			CYBOZU_TEST_EQUAL(y, z);
+			x = y + i;
+		}
+	}
+
+	void vec()
+	{
+		const size_t n = 19;
+		Fp x[n], y[n], z[n], w;
+		for (size_t i = 0; i < n; i++) {
+			x[i] = Fp(-1) - Fp(int(i * i));
+			y[i] = Fp("0x123456789abcdef") * Fp(int(i + 1)) + x[i];
+		}
+		x[1] = 0;
+		x[2] = 1;
+		y[3] = -1;
+		y[4] = x[4];
+		for (size_t k = 0; k <= n; k++) {
+			Fp::addVec(z, x, y, k);
+			for (size_t i = 0; i < k; i++) {
+				Fp::add(w, x[i], y[i]);
+				CYBOZU_TEST_EQUAL(z[i], w);
+			}
+			Fp::subVec(z, x, y, k);
+			for (size_t i = 0; i < k; i++) {
+				Fp::sub(w, x[i], y[i]);
+				CYBOZU_TEST_EQUAL(z[i], w);
+			}
+			Fp::negVec(z, x, k);
+			for (size_t i = 0; i < k; i++) {
+				Fp::neg(w, x[i]);
+				CYBOZU_TEST_EQUAL(z[i], w);
+			}
+			Fp::mulVec(z, x, y, k);
+			for (size_t i = 0; i < k; i++) {
+				Fp::mul(w, x[i], y[i]);
+				CYBOZU_TEST_EQUAL(z[i], w);
+			}
+		}
+		// z may be x
+		Fp::mulVec(x, x, y, n);
+		for (size_t i = 0; i < n; i++) {
+			CYBOZU_TEST_EQUAL(x[i], z[i]);
+		}
+	}
+
+	void smallMul()
+	{
+		const mpz_class tbl[] = {
+			0, 1, 2, 3, m - 1, m - 2, m / 2, (m + 1) / 2, m / 3, m / 8 + 1
+		};
+		const size_t n = CYBOZU_NUM_OF_ARRAY(tbl);
+		const uint64_t cTbl[] = { 0, 1, 2, 3, 12345, uint64_t(-1) >> 1 };
+		for (size_t i = 0; i < n; i++) {
+			Fp x, y, z;
+			Fp::toMont(x, tbl[i]);
+			Fp::toMont(y, tbl[n - 1 - i]);
+			Fp::mulBy2(z, x);
+			CYBOZU_TEST_EQUAL(z, x + x);
+			Fp::mulBy3(z, x);
+			CYBOZU_TEST_EQUAL(z, x + x + x);
+			Fp::mulBy4(z, x);
+			CYBOZU_TEST_EQUAL(z, x * 4);
+			Fp::mulBy8(z, x);
+			CYBOZU_TEST_EQUAL(z, x * 8);
+			Fp::sub2(z, x, y);
+			CYBOZU_TEST_EQUAL(z, x - y - y);
+			z = y;
+			Fp::sub2(z, x, z);
+			CYBOZU_TEST_EQUAL(z, x - y - y);
+			z = x;
+			Fp::mulBy8(z, z);
+			CYBOZU_TEST_EQUAL(z, x * 8);
+			for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(cTbl); j++) {
+				Fp::mulUnit(z, x, cTbl[j]);
+				CYBOZU_TEST_EQUAL(z, x * Fp(cTbl[j]));
+			}
+		}
+	}
+	void dbl()
+	{
+		typedef mie::MontFpDblT<N> FpDbl;
+		const mpz_class R = mpz_class(1) << (Fp::BlockSize * 64);
+		const mpz_class tbl[] = {
+			0, 1, 2, m - 1, m - 2, m / 2, (m + 1) / 2, R % m, m - R % m
+		};
+		const size_t n = CYBOZU_NUM_OF_ARRAY(tbl);
+		for (size_t i = 0; i < n; i++) {
+			const mpz_class& a = tbl[i];
+			const mpz_class& b = tbl[(i * 3 + 1) % n];
+			const mpz_class& c = tbl[(i * 5 + 2) % n];
+			const mpz_class& d = tbl[n - 1 - i];
+			Fp x, y, z, w, u;
+			Fp::toMont(x, a);
+			Fp::toMont(y, b);
+			Fp::toMont(z, c);
+			Fp::toMont(w, d);
+			FpDbl s, t;
+			FpDbl::mulPre(s, x, y);
+			FpDbl::mod(u, s);
+			CYBOZU_TEST_EQUAL(u, x * y);
+			mpz_class e, ex, ey;
+			mie::Gmp::setRaw(e, s.getInnerValue(), FpDbl::BlockSize);
+			mie::Gmp::setRaw(ex, x.getInnerValue(), N);
+			mie::Gmp::setRaw(ey, y.getInnerValue(), N);
+			CYBOZU_TEST_EQUAL(e, ex * ey);
+			// x * y + z * w
+			FpDbl::mulPre(t, z, w);
+			FpDbl::add(s, s, t);
+			FpDbl::mod(u, s);
+			CYBOZU_TEST_EQUAL(u, x * y + z * w);
+			// x * y - z * w
+			FpDbl::mulPre(s, x, y);
+			FpDbl::sub(s, s, t);
+			FpDbl::mod(u, s);
+			CYBOZU_TEST_EQUAL(u, x * y - z * w);
+			// z * w - x * y
+			FpDbl::mulPre(s, x, y);
+			FpDbl::sub(s, t, s);
+			FpDbl::mod(u, s);
+			CYBOZU_TEST_EQUAL(u, z * w - x * y);
+		}
+		// raw add/sub
+		Fp x("0x123456789abcdef"), y(-1);
+		FpDbl s, t, v;
+		FpDbl::mulPre(s, x, y);
+		FpDbl::mulPre(t, y, x);
+		CYBOZU_TEST_ASSERT(s == t);
+		CYBOZU_TEST_ASSERT(!FpDbl::addNc(v, s, t));
+		CYBOZU_TEST_ASSERT(!FpDbl::subNc(v, v, t));
+		CYBOZU_TEST_ASSERT(v == s);
+		v.clear();
+		CYBOZU_TEST_ASSERT(FpDbl::subNc(v, v, s));
+	}
+
 	void power()
 	{
 		Fp x, y, z;
@@ -464,6 +628,14 @@ struct Test {
 			CYBOZU_TEST_EQUAL(y, z);
 			z *= x;
 		}
+		// long exponents by the sliding window
+		const mpz_class tbl[] = { m - 1, m - 2, m / 3, mpz_class("0x123456789abcdef0123456789abcdef") };
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+			Fp::power(y, x, Zn(tbl[i].get_str()));
+			mpz_class t;
+			mie::Gmp::powMod(t, 12345, tbl[i] % m, m);
+			CYBOZU_TEST_EQUAL(y, Fp(t.get_str()));
+		}
 	}
 
 	void setRaw()
@@ -519,6 +691,126 @@ struct Test {
 			}
 		}
 	}
+	void serialize()
+	{
+		const mpz_class tbl[] = {
+			0, 1, 2, 12345, m - 1, m / 2, m / 3
+		};
+		const size_t n = CYBOZU_NUM_OF_ARRAY(tbl);
+		const size_t byteSize = Fp::getByteSize();
+		CYBOZU_TEST_EQUAL(byteSize, (mie::Gmp::getBitLen(m) + 7) / 8);
+		Fp x[n], y[n];
+		std::vector<char> buf(byteSize * n);
+		for (size_t i = 0; i < n; i++) {
+			Fp::toMont(x[i], tbl[i]);
+			CYBOZU_TEST_EQUAL(x[i].serialize(&buf[0], byteSize), byteSize);
+			mpz_class t;
+			mie::Gmp::setRaw(t, (const uint8_t*)&buf[0], byteSize);
+			CYBOZU_TEST_EQUAL(t, tbl[i]);
+			CYBOZU_TEST_EQUAL(y[i].deserialize(&buf[0], byteSize), byteSize);
+			CYBOZU_TEST_EQUAL(x[i], y[i]);
+			x[i].serialize(&buf[0], byteSize, true);
+			y[i].deserialize(&buf[0], byteSize, true);
+			CYBOZU_TEST_EQUAL(x[i], y[i]);
+		}
+		CYBOZU_TEST_EXCEPTION(x[0].serialize(&buf[0], byteSize - 1), cybozu::Exception);
+		// p is not in [0, p)
+		mie::Gmp::getRaw((uint8_t*)&buf[0], byteSize, m);
+		CYBOZU_TEST_EXCEPTION(y[0].deserialize(&buf[0], byteSize), cybozu::Exception);
+		for (int isMont = 0; isMont < 2; isMont++) {
+			CYBOZU_TEST_EQUAL(Fp::serializeVec(&buf[0], buf.size(), x, n, isMont != 0), buf.size());
+			for (size_t i = 0; i < n; i++) {
+				Fp t;
+				t.deserialize(&buf[byteSize * i], byteSize, isMont != 0);
+				CYBOZU_TEST_EQUAL(t, x[i]);
+				y[i].clear();
+			}
+			CYBOZU_TEST_EQUAL(Fp::deserializeVec(y, n, &buf[0], buf.size(), isMont != 0), buf.size());
+			for (size_t i = 0; i < n; i++) {
+				CYBOZU_TEST_EQUAL(x[i], y[i]);
+			}
+		}
+		CYBOZU_TEST_EXCEPTION(Fp::deserializeVec(y, n, &buf[0], buf.size() - 1), cybozu::Exception);
+	}
+	void inv()
+	{
+		const mpz_class tbl[] = {
+			1, 2, 3, 12345, m - 1, m - 2, m / 2, (m + 1) / 2, m / 3
+		};
+		Fp z0, z1;
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+			Fp x;
+			Fp::toMont(x, tbl[i]);
+			Fp::inv(z0, x);
+			Fp::setInvMode(Fp::InvSafeGcd);
+			Fp::inv(z1, x);
+			Fp::setInvMode(Fp::InvPre);
+			CYBOZU_TEST_EQUAL(z0, z1);
+			CYBOZU_TEST_EQUAL(z1 * x, 1);
+		}
+		Fp::setInvMode(Fp::InvSafeGcd);
+		Fp::inv(z1, 0);
+		Fp::setInvMode(Fp::InvPre);
+		CYBOZU_TEST_ASSERT(z1.isZero());
+		// invVec with zero
+		const size_t n = CYBOZU_NUM_OF_ARRAY(tbl) + 2;
+		Fp x[n], y[n];
+		for (size_t i = 0; i < n - 2; i++) {
+			Fp::toMont(x[i], tbl[i]);
+		}
+		x[n - 2] = x[3];
+		x[3] = 0;
+		x[n - 1] = 0;
+		Fp::invVec(y, x, n);
+		for (size_t i = 0; i < n; i++) {
+			if (x[i].isZero()) {
+				CYBOZU_TEST_ASSERT(y[i].isZero());
+			} else {
+				CYBOZU_TEST_EQUAL(y[i] * x[i], 1);
+			}
+		}
+		Fp::invVec(x, x, n);
+		for (size_t i = 0; i < n; i++) {
+			CYBOZU_TEST_EQUAL(x[i], y[i]);
+		}
+	}
+	void fixedExp()
+	{
+		const mpz_class tbl[] = {
+			0, 1, 2, 3, 12345, m - 1, m - 2, m / 2, (m + 1) / 2
+		};
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+			Fp x, y, z;
+			Fp::toMont(x, tbl[i]);
+			Fp::invFermat(y, x);
+			if (x.isZero()) {
+				CYBOZU_TEST_ASSERT(y.isZero());
+			} else {
+				CYBOZU_TEST_EQUAL(y * x, 1);
+			}
+			mpz_class t;
+			mie::Gmp::powMod(t, tbl[i], (m - 1) / 2, m);
+			const int s = Fp::legendre(x);
+			CYBOZU_TEST_EQUAL(s, t == 0 ? 0 : t == 1 ? 1 : -1);
+			const bool isSquare = Fp::sqrt(z, x);
+			CYBOZU_TEST_EQUAL(isSquare, s >= 0);
+			CYBOZU_TEST_EQUAL(isSquare, Fp::isSquare(x));
+			if (isSquare) {
+				CYBOZU_TEST_EQUAL(z * z, x);
+			}
+			Fp::square(y, x);
+			CYBOZU_TEST_ASSERT(Fp::sqrt(z, y));
+			CYBOZU_TEST_EQUAL(z * z, y);
+		}
+	}
+	static void addN(Fp *z, const Fp *x, const Fp *y, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) Fp::add(z[i], x[i], y[i]);
+	}
+	static void mulN(Fp *z, const Fp *x, const Fp *y, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) Fp::mul(z[i], x[i], y[i]);
+	}
 	void bench()
 	{
 		Fp x("-123456789");
@@ -526,7 +818,33 @@ struct Test {
 		CYBOZU_BENCH("add", operator+, x, x);
 		CYBOZU_BENCH("sub", operator-, x, y);
 		CYBOZU_BENCH("mul", operator*, x, x);
+		CYBOZU_BENCH("sqr", Fp::square, x, x);
+		CYBOZU_BENCH("mulBy8", Fp::mulBy8, x, x);
+		CYBOZU_BENCH("sub2", Fp::sub2, x, x, y);
 		CYBOZU_BENCH("div", y += x; operator/, x, y);
+		CYBOZU_BENCH("inv(preInv)", Fp::inv, x, x);
+		Fp::setInvMode(Fp::InvSafeGcd);
+		CYBOZU_BENCH("inv(safegcd)", Fp::inv, x, x);
+		Fp::setInvMode(Fp::InvPre);
+		CYBOZU_BENCH("inv(Fermat)", Fp::invFermat, x, x);
+		{
+			Zn e(-2);
+			CYBOZU_BENCH("power(p-2)", Fp::power, x, x, e);
+		}
+		CYBOZU_BENCH("legendre", Fp::legendre, x);
+		CYBOZU_BENCH("isSquare", Fp::isSquare, x);
+		CYBOZU_BENCH("sqrt", Fp::sqrt, x, x);
+		const size_t n = 64;
+		Fp xv[n], yv[n], zv[n];
+		for (size_t i = 0; i < n; i++) {
+			xv[i] = x + Fp(int(i));
+			yv[i] = y - Fp(int(i));
+		}
+		CYBOZU_BENCH("add x64", addN, zv, xv, yv, n);
+		CYBOZU_BENCH("addVec x64", Fp::addVec, zv, xv, yv, n);
+		CYBOZU_BENCH("mul x64", mulN, zv, xv, yv, n);
+		CYBOZU_BENCH("mulLoop x64", Fp::mulLoop, zv, xv, yv, n);
+		CYBOZU_BENCH("mulVec x64", Fp::mulVec, zv, xv, yv, n);
 	}
 };
 
@@ -642,6 +960,8 @@ CYBOZU_TEST_AUTO(test4)
 		"0x2523648240000001ba344d80000000086121000000000013a700000000000013",
 		"0x7523648240000001ba344d80000000086121000000000013a700000000000017",
 		"0x800000000000000000000000000000000000000000000000000000000000005f",
+		"0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f", // secp256k1
+		"0xffffffffffffffffffffffffffffffff000000000000000000000001", // NIST P-224, p = 1 mod 2^96
 		"0xffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff43", // max prime
 	};
 	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
@@ -674,6 +994,334 @@ CYBOZU_TEST_AUTO(test9)
 	}
 }
 
+/*
+	the generic montgomery reduction for the special primes
+	and the same Montgomery form in both cases
+*/
+CYBOZU_TEST_AUTO(specialMod)
+{
+	const char *secp256k1 = "0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f";
+	MontFp4::setModulo(secp256k1);
+	CYBOZU_TEST_ASSERT(MontFp4::fg_.isSpecialMod());
+	const MontFp4 x("0x123456789abcdef0123456789abcdef0123456789abcdef");
+	char buf[32];
+	CYBOZU_TEST_EQUAL(x.serialize(buf, sizeof(buf), true), sizeof(buf));
+	MontFp3::setUseSpecialMod(false);
+	MontFp4::setUseSpecialMod(false);
+	MontFp9::setUseSpecialMod(false);
+	MontFp4::setModulo(secp256k1);
+	CYBOZU_TEST_ASSERT(!MontFp4::fg_.isSpecialMod());
+	MontFp4 y;
+	CYBOZU_TEST_EQUAL(y.deserialize(buf, sizeof(buf), true), sizeof(buf));
+	CYBOZU_TEST_EQUAL(x, y);
+	Test<3>().run("0xfffffffffffffffffffffffffffffffffffffffeffffee37"); // secp192k1
+	Test<4>().run(secp256k1);
+	Test<9>().run("0x1ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff"); // P-521
+	MontFp3::setUseSpecialMod(true);
+	MontFp4::setUseSpecialMod(true);
+	MontFp9::setUseSpecialMod(true);
+}
+
+/*
+	mulVec by the AVX-512 IFMA kernel if the cpu has it
+*/
+CYBOZU_TEST_AUTO(ifmaSimd)
+{
+	MontFp4::setUseIfmaSimd(true);
+	MontFp6::setUseIfmaSimd(true);
+	MontFp9::setUseIfmaSimd(true);
+	Test<4>().run("0x2523648240000001ba344d80000000086121000000000013a700000000000013");
+	Test<4>().run("0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f"); // secp256k1
+	Test<6>().run("0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffeffffffff0000000000000000ffffffff");
+	Test<9>().run("0x1ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff"); // P-521
+	printf("simdN=%d\n", MontFp9::fg_.simdN_);
+	MontFp4::setUseIfmaSimd(false);
+	MontFp6::setUseIfmaSimd(false);
+	MontFp9::setUseIfmaSimd(false);
+}
+
+/*
+	"0x..." of 2^bit + d
+*/
+std::string getModStr(int bit, int d)
+{
+	mpz_class p = 1;
+	p <<= bit;
+	p += d;
+	std::string str;
+	mie::Gmp::toStr(str, p, 16);
+	return "0x" + str;
+}
+
+CYBOZU_TEST_AUTO(test16)
+{
+	Test<16> test;
+	const std::string tbl[] = {
+		getModStr(1023, 1155),
+		getModStr(1024, -105), // max prime
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		printf("prime=%s\n", tbl[i].c_str());
+		test.run(tbl[i].c_str());
+	}
+}
+
+CYBOZU_TEST_AUTO(test32)
+{
+	Test<32> test;
+	const std::string tbl[] = {
+		getModStr(2047, 1919),
+		getModStr(2048, -1557), // max prime
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		printf("prime=%s\n", tbl[i].c_str());
+		test.run(tbl[i].c_str());
+	}
+}
+
+CYBOZU_TEST_AUTO(test48)
+{
+	Test<48> test;
+	const std::string tbl[] = {
+		getModStr(3071, 2291),
+		getModStr(3072, -47), // max prime
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		printf("prime=%s\n", tbl[i].c_str());
+		test.run(tbl[i].c_str());
+	}
+}
+
+CYBOZU_TEST_AUTO(test64)
+{
+	Test<64> test;
+	const std::string tbl[] = {
+		getModStr(4095, 579),
+		getModStr(4096, -2549), // max prime
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		printf("prime=%s\n", tbl[i].c_str());
+		test.run(tbl[i].c_str());
+	}
+}
+
+CYBOZU_TEST_AUTO(context)
+{
+	typedef mie::MontFpContext<4> Context;
+	typedef Context::Elem Elem;
+	const char *pTbl[] = {
+		"0x2523648240000001ba344d80000000086121000000000013a700000000000013",
+		"0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f",
+	};
+	const Context c0(pTbl[0]), c1(pTbl[1]);
+	const Context *ctxTbl[] = { &c0, &c1 };
+	const int xTbl[] = { 0, 1, 5, -3, 12345 };
+	Elem z0;
+	c0.set(z0, 7);
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(xTbl); i++) {
+		for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(ctxTbl); j++) {
+			const Context& c = *ctxTbl[j];
+			const mpz_class m(pTbl[j]);
+			const mpz_class mx = (xTbl[i] + m) % m;
+			const mpz_class my("0x123456789abcdef0123456789abcdef");
+			Elem x, y, z;
+			c.set(x, xTbl[i]);
+			c.set(y, my);
+			mpz_class t;
+			c.get(t, x);
+			CYBOZU_TEST_EQUAL(t, mx);
+			c.add(z, x, y);
+			c.get(t, z);
+			CYBOZU_TEST_EQUAL(t, (mx + my) % m);
+			c.sub(z, x, y);
+			c.get(t, z);
+			CYBOZU_TEST_EQUAL(t, (mx - my + m) % m);
+			c.mul(z, x, y);
+			c.get(t, z);
+			CYBOZU_TEST_EQUAL(t, (mx * my) % m);
+			c.square(z, y);
+			c.get(t, z);
+			CYBOZU_TEST_EQUAL(t, (my * my) % m);
+			c.div(z, x, y);
+			c.mul(z, z, y);
+			CYBOZU_TEST_ASSERT(z == x);
+			c.power(z, y, m - 1);
+			CYBOZU_TEST_EQUAL(c.toStr(z), "1");
+			const mpz_class e("0xfedcba9876543210fedcba9876543210f");
+			c.power(z, x, e);
+			mie::Gmp::powMod(t, mx, e, m);
+			CYBOZU_TEST_EQUAL(c.toStr(z), t.get_str());
+			CYBOZU_TEST_EQUAL(c.toStr(x), mx.get_str());
+			CYBOZU_TEST_EQUAL(c.toStr(x, 16), mx.get_str(16));
+			CYBOZU_TEST_EQUAL(c.toStr(x, 2), mx.get_str(2));
+			c.set(z, mx.get_str());
+			CYBOZU_TEST_ASSERT(z == x);
+			c.set(z, "0x" + mx.get_str(16));
+			CYBOZU_TEST_ASSERT(z == x);
+			c.set(z, "-" + mx.get_str());
+			c.add(z, z, x);
+			CYBOZU_TEST_ASSERT(z.isZero());
+		}
+	}
+	CYBOZU_TEST_EXCEPTION(c0.set(z0, pTbl[0]), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(c0.toStr(z0, 8), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(c0.power(z0, z0, -1), cybozu::Exception);
+	// vector ops of one context do not depend on the other
+	const size_t n = 9;
+	Elem x[n], y[n], z[n], w;
+	for (size_t i = 0; i < n; i++) {
+		c0.set(x[i], int(i * 7 + 1));
+		c0.set(y[i], int(i * 3 + 2));
+	}
+	c1.mulVec(z, x, y, n);
+	c0.mulVec(z, x, y, n);
+	for (size_t i = 0; i < n; i++) {
+		c0.mul(w, x[i], y[i]);
+		CYBOZU_TEST_ASSERT(z[i] == w);
+	}
+	c0.negVec(z, x, n);
+	for (size_t i = 0; i < n; i++) {
+		c0.neg(w, x[i]);
+		CYBOZU_TEST_ASSERT(z[i] == w);
+	}
+}
+
+CYBOZU_TEST_AUTO(dynMontFp)
+{
+	typedef mie::DynMontFp Fp;
+	const struct {
+		const char *p;
+		size_t n;
+	} tbl[] = {
+		{ "0xfffffffffffffffffffffffffffffffeffffffffffffffff", 3 },
+		{ "0x2523648240000001ba344d80000000086121000000000013a700000000000013", 4 },
+		{ "0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffeffffffff0000000000000000ffffffff", 6 },
+		{ "0x1ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff", 9 },
+		{ "0x2523648240000001ba344d80000000086121000000000013a700000000000013", 4 },
+		{ "0xffffffffffffffffffffffffffffff61", 2 },
+		{ "0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f", 4 }, // secp256k1
+		{ "0x14dd7193bd69fe29d76d4330f1446beab0c11fdecb91ce375bc8fbbcbde5c0994164d8399f767ccd", 5 },
+		{ "0x1be5bb2f1cfb10f62827688de6a16a3b0d464138a62332553fc1ea36f17fd374c6a5387777330bdbd7210dff076ce2ef87b0b125ec1d7dad", 7 },
+		{ "0x815c33b2df1461aaf8eb18b90074513021da8978206f5c6671e0c07e9e115e4b9e30691c238642ea126a1e48cc11d357c30d8b7628dbd25e63b229f1c4069583", 8 },
+	};
+	// the second round uses the AVX-512 IFMA kernel in mulVec if the cpu has it
+	const size_t tblN = CYBOZU_NUM_OF_ARRAY(tbl);
+	for (size_t k = 0; k < tblN * 2; k++) {
+		const size_t i = k % tblN;
+		Fp::setUseIfmaSimd(k >= tblN);
+		Fp::setModulo(tbl[i].p);
+		CYBOZU_TEST_EQUAL(Fp::getLimbN(), tbl[i].n);
+		const mpz_class m(tbl[i].p);
+		const mpz_class mx("0x123456789abcdef0123456789abcdef");
+		const mpz_class my = m - 12345;
+		Fp x(mx.get_str()), y(my.get_str()), z;
+		mpz_class t;
+		Fp::fromMont(t, x);
+		CYBOZU_TEST_EQUAL(t, mx);
+		CYBOZU_TEST_EQUAL(y.toStr(16), my.get_str(16));
+		Fp::add(z, x, y);
+		CYBOZU_TEST_EQUAL(z.toStr(), mpz_class((mx + my) % m).get_str());
+		Fp::sub(z, x, y);
+		CYBOZU_TEST_EQUAL(z.toStr(), mpz_class((mx - my + m) % m).get_str());
+		Fp::mul(z, x, y);
+		CYBOZU_TEST_EQUAL(z.toStr(), mpz_class((mx * my) % m).get_str());
+		Fp::square(z, y);
+		CYBOZU_TEST_EQUAL(z.toStr(), mpz_class((my * my) % m).get_str());
+		CYBOZU_TEST_EQUAL(Fp(-1).toStr(), mpz_class(m - 1).get_str());
+		for (int mode = Fp::InvPre; mode <= Fp::InvSafeGcd; mode++) {
+			Fp::setInvMode(mode);
+			Fp::div(z, x, y);
+			CYBOZU_TEST_EQUAL(z * y, x);
+		}
+		Fp::setInvMode(Fp::InvPre);
+		Fp::power(z, x, 5);
+		CYBOZU_TEST_EQUAL(z, x * x * x * x * x);
+		uint8_t buf[128];
+		const size_t size = x.serialize(buf, sizeof(buf));
+		CYBOZU_TEST_EQUAL(size, (mie::Gmp::getBitLen(m) + 7) / 8);
+		z.deserialize(buf, size);
+		CYBOZU_TEST_EQUAL(z, x);
+		CYBOZU_TEST_EXCEPTION(Fp(m.get_str()), cybozu::Exception);
+		// arrays have the stride maxN for any N
+		const size_t n = 17;
+		Fp xv[n], yv[n], zv[n];
+		for (size_t j = 0; j < n; j++) {
+			xv[j] = int(j * 7 + 1);
+			yv[j] = -int(j * 3 + 2);
+		}
+		Fp::mulVec(zv, xv, yv, n);
+		for (size_t j = 0; j < n; j++) CYBOZU_TEST_EQUAL(zv[j], xv[j] * yv[j]);
+		Fp::addVec(zv, xv, yv, n);
+		for (size_t j = 0; j < n; j++) CYBOZU_TEST_EQUAL(zv[j], xv[j] + yv[j]);
+		Fp::subVec(zv, xv, yv, n);
+		for (size_t j = 0; j < n; j++) CYBOZU_TEST_EQUAL(zv[j], xv[j] - yv[j]);
+	}
+	Fp::setUseIfmaSimd(false);
+	CYBOZU_TEST_EXCEPTION(Fp::setModulo("0xffffffffffffffc5"), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(Fp::setModulo("0x" + std::string(150, 'f')), cybozu::Exception);
+}
+
+/*
+	cost of inv per element
+*/
+CYBOZU_TEST_AUTO(invVecBench)
+{
+	typedef MontFp4 Fp;
+	Fp::setModulo("0x2523648240000001ba344d80000000086121000000000013a700000000000013");
+	const size_t maxN = 1024;
+	std::vector<Fp> x(maxN), y(maxN);
+	for (size_t i = 0; i < maxN; i++) {
+		x[i] = int(i + 1);
+	}
+	const size_t tbl[] = { 1, 2, 4, 8, 16, 64, 256, 1024 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		const size_t n = tbl[i];
+		const int C = int(100000 / n) + 1;
+		clock_t begin = clock();
+		for (int j = 0; j < C; j++) {
+			Fp::invVec(&y[0], &x[0], n);
+		}
+		clock_t end = clock();
+		const double invVecT = (end - begin) / double(CLOCKS_PER_SEC) / C / n * 1e6;
+		begin = clock();
+		for (int j = 0; j < C; j++) {
+			for (size_t k = 0; k < n; k++) Fp::inv(y[k], x[k]);
+		}
+		end = clock();
+		const double invT = (end - begin) / double(CLOCKS_PER_SEC) / C / n * 1e6;
+		printf("n=%4d invVec %.3fusec/elem inv %.3fusec/elem\n", (int)n, invVecT, invT);
+	}
+}
+
+template<size_t N>
+void benchPowMod(const std::string& pStr, int C)
+{
+	typedef mie::MontFpT<N> Fp;
+	Fp::setModulo(pStr);
+	Zn::setModulo(pStr);
+	const mpz_class m(pStr);
+	const Fp x(-3);
+	const Zn e(-5);
+	const mpz_class mx = toGmp(x);
+	const mpz_class me = toGmp(e);
+	Fp y;
+	mpz_class z;
+	Fp::power(y, x, e);
+	mie::Gmp::powMod(z, mx, me, m);
+	CYBOZU_TEST_EQUAL(toGmp(y), z);
+	printf("bit=%d\n", (int)N * 64);
+	CYBOZU_BENCH_C("Mont:powMod", C, Fp::power, y, x, e);
+	CYBOZU_BENCH_C("Gmp:powMod ", C, mie::Gmp::powMod, z, mx, me, m);
+}
+
+CYBOZU_TEST_AUTO(powModBench)
+{
+	benchPowMod<16>(getModStr(1024, -105), 300);
+	benchPowMod<32>(getModStr(2048, -1557), 50);
+	benchPowMod<48>(getModStr(3072, -47), 20);
+	benchPowMod<64>(getModStr(4096, -2549), 10);
+}
+
 CYBOZU_TEST_AUTO(toStr16)
 {
 	const char *tbl[] = {
@@ -721,6 +1369,49 @@ CYBOZU_TEST_AUTO(fromStr16)
 	}
 }
 
+CYBOZU_TEST_AUTO(str10)
+{
+	const char *tbl[] = {
+		"0",
+		"5",
+		"123",
+		"9999999999999999999",
+		"10000000000000000000",
+		"18446744073709551616",
+		"123456789012345678901234567890123456789",
+		"6277101735386680763835789423207666416102355444464034512658", // p - 1
+	};
+	MontFp3::setModulo("0xffffffffffffffffffffffffffffffffffffffffffffff13");
+	const size_t n = CYBOZU_NUM_OF_ARRAY(tbl);
+	std::string strTbl[n], outTbl[n];
+	for (size_t i = 0; i < n; i++) {
+		MontFp3 x(tbl[i]);
+		std::string str;
+		x.toStr(str);
+		CYBOZU_TEST_EQUAL(str, tbl[i]);
+		mpz_class y;
+		MontFp3::fromMont(y, x);
+		CYBOZU_TEST_EQUAL(y, mpz_class(tbl[i]));
+		strTbl[i] = tbl[i];
+	}
+	CYBOZU_TEST_EXCEPTION(MontFp3("6277101735386680763835789423207666416102355444464034512659"), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(MontFp3("12a"), cybozu::Exception);
+	MontFp3 xTbl[n];
+	MontFp3::fromStrVec(xTbl, strTbl, n);
+	MontFp3::toStrVec(outTbl, xTbl, n);
+	for (size_t i = 0; i < n; i++) {
+		CYBOZU_TEST_EQUAL(xTbl[i], MontFp3(tbl[i]));
+		CYBOZU_TEST_EQUAL(outTbl[i], tbl[i]);
+	}
+	strTbl[1] = "-5";
+	strTbl[2] = "0x123";
+	MontFp3::fromStrVec(xTbl, strTbl, n);
+	CYBOZU_TEST_EQUAL(xTbl[1], -5);
+	CYBOZU_TEST_EQUAL(xTbl[2], 0x123);
+	MontFp3::toStrVec(outTbl, xTbl, n, 16);
+	CYBOZU_TEST_EQUAL(outTbl[2], "123");
+}
+
 #if 0
 CYBOZU_TEST_AUTO(toStr16bench)
 {
@@ -743,7 +1434,15 @@ CYBOZU_TEST_AUTO(toStr16bench)
 		CYBOZU_BENCH_C("Gmp:toStr ", C, mie::Gmp::toStr, str2, y, 16);
 		str2.insert(0, "0x");
 		CYBOZU_TEST_EQUAL(str, str2);
+		CYBOZU_BENCH_C("Mont:toStr10", C, x.toStr, str, 10);
+		CYBOZU_BENCH_C("Gmp:toStr10 ", C, mie::Gmp::toStr, str2, y, 10);
+		CYBOZU_TEST_EQUAL(str, str2);
 	}
+	const size_t n = 64;
+	MontFp3 xv[n];
+	std::string strv[n];
+	for (size_t i = 0; i < n; i++) xv[i] = MontFp3(tbl[i % CYBOZU_NUM_OF_ARRAY(tbl)]) + int(i);
+	CYBOZU_BENCH_C("Mont:toStrVec10 x64", C / n, MontFp3::toStrVec, strv, xv, n, 10);
 }
 
 CYBOZU_TEST_AUTO(fromStr16bench)
@@ -772,6 +1471,19 @@ CYBOZU_TEST_AUTO(fromStr16bench)
 		mie::Gmp::toStr(str2, y, 16);
 		str2.insert(0, "0x");
 		CYBOZU_TEST_EQUAL(str, str2);
+		// decimal
+		mie::Gmp::toStr(str, y, 10);
+		CYBOZU_BENCH_C("Mont:fromStr10", C, x.fromStr, str);
+		CYBOZU_BENCH_C("Gmp:fromStr10 ", C, mie::Gmp::fromStr, y, str, 10);
+		x.toStr(str2, 10);
+		CYBOZU_TEST_EQUAL(str, str2);
+	}
+	const size_t n = 64;
+	MontFp3 xv[n];
+	std::string strv[n];
+	for (size_t i = 0; i < n; i++) {
+		(MontFp3(tbl[i % CYBOZU_NUM_OF_ARRAY(tbl)]) + int(i)).toStr(strv[i], 10);
 	}
+	CYBOZU_BENCH_C("Mont:fromStrVec10 x64", C / n, MontFp3::fromStrVec, xv, strv, n, 10);
 }
 #endif
@@ -0,0 +1,148 @@
+#define PUT(x) std::cout << #x "=" << (x) << std::endl
+#include <cybozu/test.hpp>
+#include <cybozu/benchmark.hpp>
+#include <mie/gmp_util.hpp>
+#include <mie/static_mont_fp.hpp>
+#include <mie/ec.hpp>
+#include <mie/ecparam.hpp>
+#include <time.h>
+
+struct ZnTag;
+typedef mie::FpT<mie::Gmp, ZnTag> Zn;
+typedef mie::FpT<mie::Gmp> GmpFp;
+
+template<class Param>
+struct Test {
+	typedef mie::StaticMontFp<Param> Fp;
+	typedef mie::EcT<Fp> Ec;
+	typedef mie::EcT<GmpFp> GmpEc;
+	const mie::EcParam& para;
+	mpz_class m;
+	Test(const mie::EcParam& para)
+		: para(para)
+		, m(para.p)
+	{
+		Fp::setModulo(para.p);
+		GmpFp::setModulo(para.p);
+		Zn::setModulo(para.n);
+		Ec::setParam(para.a, para.b);
+		GmpEc::setParam(para.a, para.b);
+	}
+	void cstr() const
+	{
+		CYBOZU_TEST_EQUAL(Fp::getModBitLen(), GmpFp::getModBitLen());
+		std::string str;
+		Fp::getModulo(str);
+		CYBOZU_TEST_EQUAL(str, m.get_str());
+		CYBOZU_TEST_EXCEPTION(Fp::setModulo("0x123"), cybozu::Exception);
+		CYBOZU_TEST_EXCEPTION(Fp(m.get_str()), cybozu::Exception);
+		CYBOZU_TEST_EQUAL(Fp(-1).toStr(), mpz_class(m - 1).get_str());
+		CYBOZU_TEST_EQUAL(Fp(5) + Fp(-5), 0);
+		CYBOZU_TEST_EQUAL(Fp("0x123").toStr(16), "123");
+		const mpz_class R = (mpz_class(1) << (Fp::N * 64)) % m;
+		mpz_class t;
+		mie::Gmp::setRaw(t, Param::getR(), Fp::N);
+		CYBOZU_TEST_EQUAL(t, R);
+		CYBOZU_TEST_ASSERT(memcmp(Fp(1).getInnerValue(), Param::getR(), sizeof(uint64_t) * Fp::N) == 0);
+		mie::Gmp::setRaw(t, Param::getRR(), Fp::N);
+		CYBOZU_TEST_EQUAL(t, R * R % m);
+	}
+	void ope() const
+	{
+		const mpz_class tbl[] = {
+			0, 1, 2, 3, 12345, m - 1, m - 2, m / 2, (m + 1) / 2, m / 3, (m * 2) / 3,
+		};
+		const size_t n = CYBOZU_NUM_OF_ARRAY(tbl);
+		for (size_t i = 0; i < n; i++) {
+			const Fp x(tbl[i].get_str());
+			const GmpFp gx(tbl[i].get_str());
+			CYBOZU_TEST_EQUAL(x.toStr(), tbl[i].get_str());
+			for (size_t j = 0; j < n; j++) {
+				const Fp y(tbl[j].get_str());
+				const GmpFp gy(tbl[j].get_str());
+				CYBOZU_TEST_EQUAL((x + y).toStr(), (gx + gy).toStr());
+				CYBOZU_TEST_EQUAL((x - y).toStr(), (gx - gy).toStr());
+				CYBOZU_TEST_EQUAL((x * y).toStr(), (gx * gy).toStr());
+				if (!y.isZero()) {
+					CYBOZU_TEST_EQUAL((x / y).toStr(), (gx / gy).toStr());
+				}
+			}
+			Fp z;
+			Fp::square(z, x);
+			CYBOZU_TEST_EQUAL(z, x * x);
+			CYBOZU_TEST_EQUAL((-x).toStr(), (-gx).toStr());
+			Fp::inv(z, x);
+			if (x.isZero()) {
+				CYBOZU_TEST_ASSERT(z.isZero());
+			} else {
+				CYBOZU_TEST_EQUAL(z * x, 1);
+			}
+			uint8_t buf[128];
+			const size_t size = x.serialize(buf, sizeof(buf));
+			CYBOZU_TEST_EQUAL(size, GmpFp::getByteSize());
+			z.deserialize(buf, size);
+			CYBOZU_TEST_EQUAL(z, x);
+		}
+	}
+	void ec() const
+	{
+		Fp x(para.gx);
+		Fp y(para.gy);
+		Ec P(x, y);
+		GmpEc gP(GmpFp(para.gx), GmpFp(para.gy));
+		const char *kTbl[] = { "1", "2", "12345", "0x123456789abcdef0123456789abcdef" };
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(kTbl); i++) {
+			const Zn k(kTbl[i]);
+			Ec Q;
+			GmpEc gQ;
+			Ec::power(Q, P, k);
+			GmpEc::power(gQ, gP, k);
+			std::ostringstream os1, os2;
+			os1 << Q;
+			os2 << gQ;
+			CYBOZU_TEST_EQUAL(os1.str(), os2.str());
+		}
+		Ec Q;
+		Ec::power(Q, P, Zn(-1));
+		CYBOZU_TEST_EQUAL(Q, -P);
+	}
+	void bench() const
+	{
+		Fp x(para.gx), y(para.gy);
+		GmpFp gx(para.gx), gy(para.gy);
+		CYBOZU_BENCH("add   ", Fp::add, x, x, y);
+		CYBOZU_BENCH("mul   ", Fp::mul, x, x, y);
+		CYBOZU_BENCH("Gmp:mul", GmpFp::mul, gx, gx, gy);
+		CYBOZU_BENCH("inv   ", x += y; Fp::inv, x, x);
+		Ec P(Fp(para.gx), Fp(para.gy));
+		Ec Q = P + P;
+		CYBOZU_BENCH("ec:add", Ec::add, Q, Q, P);
+		CYBOZU_BENCH("ec:dbl", Ec::dbl, Q, Q);
+		const Zn k("-3");
+		CYBOZU_BENCH("ec:pow", Ec::power, Q, P, k);
+		GmpEc gP(GmpFp(para.gx), GmpFp(para.gy));
+		GmpEc gQ = gP + gP;
+		CYBOZU_BENCH("Gmp:ec:pow", GmpEc::power, gQ, gP, k);
+	}
+	void run() const
+	{
+		puts(para.name);
+		cstr();
+		ope();
+		ec();
+#ifdef NDEBUG
+		bench();
+#endif
+	}
+private:
+	Test(const Test&);
+	void operator=(const Test&);
+};
+
+CYBOZU_TEST_AUTO(secp160k1) { Test<mie::static_param::secp160k1>(mie::ecparam::secp160k1).run(); }
+CYBOZU_TEST_AUTO(secp192k1) { Test<mie::static_param::secp192k1>(mie::ecparam::secp192k1).run(); }
+CYBOZU_TEST_AUTO(secp224k1) { Test<mie::static_param::secp224k1>(mie::ecparam::secp224k1).run(); }
+CYBOZU_TEST_AUTO(secp256k1) { Test<mie::static_param::secp256k1>(mie::ecparam::secp256k1).run(); }
+CYBOZU_TEST_AUTO(NIST_P192) { Test<mie::static_param::NIST_P192>(mie::ecparam::NIST_P192).run(); }
+CYBOZU_TEST_AUTO(NIST_P224) { Test<mie::static_param::NIST_P224>(mie::ecparam::NIST_P224).run(); }
+CYBOZU_TEST_AUTO(NIST_P256) { Test<mie::static_param::NIST_P256>(mie::ecparam::NIST_P256).run(); }